@@ -0,0 +1,149 @@
+#include "framebuffer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace data
+{
+
+    static const uint32_t shared_frame_magic = 0x657A6662; //"ezfb"
+
+    FrameBuffer::FrameBuffer()
+        : m_data(nullptr), m_width(0), m_height(0), m_stride(0), m_format(PixelFormat::RGB_DOUBLE) { }
+
+    FrameBuffer::FrameBuffer(void *data, size_t w, size_t h, PixelFormat format, size_t stride)
+        : m_data((unsigned char*)data), m_width(w), m_height(h), m_format(format)
+    {
+        m_stride = stride == 0 ? w * pixel_size(format) : stride;
+        if(m_stride < w * pixel_size(format)) throw Exception(__PRETTY_FUNCTION__, "stride smaller than a row");
+    }
+
+    FrameBuffer::~FrameBuffer() { }
+
+    size_t FrameBuffer::width() const { return m_width; }
+    size_t FrameBuffer::height() const { return m_height; }
+    size_t FrameBuffer::stride() const { return m_stride; }
+    PixelFormat FrameBuffer::format() const { return m_format; }
+    unsigned char* FrameBuffer::row(size_t y) { return m_data + y * m_stride; }
+    const unsigned char* FrameBuffer::row(size_t y) const { return m_data + y * m_stride; }
+
+    void FrameBuffer::store(size_t x, size_t y, const Vector3d *pixels, size_t count)
+    {
+        convert_pixels(pixels, count, m_format, row(y) + x * pixel_size(m_format));
+    }
+
+    void FrameBuffer::flush(size_t x, size_t y, size_t w, size_t h) { }
+
+    std::string FrameBuffer::to_string() const
+    {
+        std::string s = "data::FrameBuffer - dimensions [";
+        s += std::to_string(m_width) + ",";
+        s += std::to_string(m_height) + "] " + format_name(m_format);
+        return s;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    // Shared memory
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    SharedFrameBuffer::SharedFrameBuffer(const std::string &name, size_t w, size_t h, PixelFormat format)
+        : m_name(name), m_owner(true), m_size(0), m_header(nullptr)
+    {
+        m_width = w;
+        m_height = h;
+        m_format = format;
+        m_stride = w * pixel_size(format);
+
+        //rows start on a cache line
+        size_t offset = ((sizeof(SharedFrameHeader) + 63) / 64) * 64;
+        size_t size = offset + m_stride * h;
+
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "shm_open failed - " + std::string(strerror(errno)));
+        if(ftruncate(fd, size) != 0)
+        {
+            std::string error = strerror(errno);
+            close(fd);
+            shm_unlink(name.c_str());
+            throw Exception(__PRETTY_FUNCTION__, "failed to size shared memory - " + error);
+        }
+        map(fd, size);
+
+        m_header->width = w;
+        m_header->height = h;
+        m_header->format = uint32_t(format);
+        m_header->stride = m_stride;
+        m_header->data_offset = offset;
+        m_header->generation.store(0);
+        m_header->magic = shared_frame_magic; //last, the header is valid now.
+
+        m_data = (unsigned char*)m_header + offset;
+    }
+
+    SharedFrameBuffer::SharedFrameBuffer(const std::string &name)
+        : m_name(name), m_owner(false), m_size(0), m_header(nullptr)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "shm_open failed - " + std::string(strerror(errno)));
+
+        struct stat info;
+        if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SharedFrameHeader))
+        {
+            close(fd);
+            throw Exception(__PRETTY_FUNCTION__, "not a shared framebuffer: " + name);
+        }
+        map(fd, info.st_size);
+
+        if(m_header->magic != shared_frame_magic
+            || m_header->data_offset + m_header->stride * m_header->height > m_size)
+        {
+            munmap(m_header, m_size);
+            throw Exception(__PRETTY_FUNCTION__, "not a shared framebuffer: " + name);
+        }
+
+        m_width = m_header->width;
+        m_height = m_header->height;
+        m_format = PixelFormat(m_header->format);
+        m_stride = m_header->stride;
+        m_data = (unsigned char*)m_header + m_header->data_offset;
+    }
+
+    SharedFrameBuffer::~SharedFrameBuffer()
+    {
+        munmap(m_header, m_size);
+        if(m_owner) shm_unlink(m_name.c_str());
+    }
+
+    const SharedFrameHeader& SharedFrameBuffer::header() const { return *m_header; }
+
+    void SharedFrameBuffer::flush(size_t x, size_t y, size_t w, size_t h)
+    {
+        m_header->generation.fetch_add(1, std::memory_order_release);
+    }
+
+    std::string SharedFrameBuffer::to_string() const
+    {
+        return "data::SharedFrameBuffer " + m_name + " - dimensions ["
+            + std::to_string(m_width) + "," + std::to_string(m_height) + "] " + format_name(m_format);
+    }
+
+    void SharedFrameBuffer::map(int fd, size_t size)
+    {
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        std::string error = strerror(errno);
+        close(fd);
+
+        if(memory == MAP_FAILED)
+        {
+            if(m_owner) shm_unlink(m_name.c_str());
+            throw Exception(__PRETTY_FUNCTION__, "mmap failed - " + error);
+        }
+
+        m_header = (SharedFrameHeader*)memory;
+        m_size = size;
+    }
+
+}
@@ -0,0 +1,92 @@
+#ifndef DATA_FRAMEBUFFER_HPP
+#define DATA_FRAMEBUFFER_HPP
+
+#include <atomic>
+#include "pixelformat.hpp"
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        View on pixel memory owned by someone else, with a caller chosen format and row stride.
+        Renders store rows into it converting from Vector3d, and call flush for every finished rectangle.
+        The framebuffer never frees the memory, so one buffer can be reused for every frame.
+    */
+
+    class FrameBuffer : public Object
+    {
+    public:
+        FrameBuffer(void *data, size_t w, size_t h, PixelFormat format, size_t stride = 0); //stride 0 = packed rows
+        FrameBuffer(const FrameBuffer&) = delete;
+        virtual ~FrameBuffer();
+
+        size_t width() const;
+        size_t height() const;
+        size_t stride() const; //bytes per row
+        PixelFormat format() const;
+
+        unsigned char* row(size_t y);
+        const unsigned char* row(size_t y) const;
+
+        //stores count pixels starting at (x, y)
+        void store(size_t x, size_t y, const Vector3d *pixels, size_t count);
+        //called once the rectangle is completely stored
+        virtual void flush(size_t x, size_t y, size_t w, size_t h);
+
+        virtual std::string to_string() const;
+
+    protected:
+        FrameBuffer();
+
+        unsigned char *m_data;
+        size_t m_width;
+        size_t m_height;
+        size_t m_stride;
+        PixelFormat m_format;
+    };
+
+    /*
+        Framebuffer in a POSIX shared memory segment, so another process (a viewer) can display
+        tiles while they are rendered without copying. The segment starts with a header describing
+        the layout, followed by the pixel rows. Every flush increments header.generation, viewers
+        can poll it to see when new pixels are available.
+    */
+
+    struct SharedFrameHeader
+    {
+        uint32_t magic;
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint64_t stride;
+        uint64_t data_offset; //from the start of the segment
+        std::atomic<uint64_t> generation;
+    };
+
+    class SharedFrameBuffer : public FrameBuffer
+    {
+    public:
+        //creates (or resizes) the segment name, which is removed again on destruction.
+        SharedFrameBuffer(const std::string &name, size_t w, size_t h, PixelFormat format);
+        //attaches to an existing segment created by another process.
+        SharedFrameBuffer(const std::string &name);
+        virtual ~SharedFrameBuffer();
+
+        const SharedFrameHeader& header() const;
+
+        virtual void flush(size_t x, size_t y, size_t w, size_t h);
+        virtual std::string to_string() const;
+
+    protected:
+        std::string m_name;
+        bool m_owner;
+        size_t m_size;
+        SharedFrameHeader *m_header;
+
+        void map(int fd, size_t size);
+    };
+
+}
+
+#endif
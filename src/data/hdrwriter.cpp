@@ -0,0 +1,156 @@
+#include "hdrwriter.hpp"
+
+#include <vector>
+#include <cstring>
+#include <fstream>
+
+namespace data
+{
+
+    static bool little_endian()
+    {
+        uint16_t one = 1;
+        unsigned char first;
+        memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    static std::ofstream open_output(const std::string &file)
+    {
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        if(out.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to open " + file);
+        return out;
+    }
+
+    //row y as floats (format RGB_FLOAT) or halfs (RGB_HALF), pointing into the image when possible.
+    static const void* row_as(const Image &image, size_t y, PixelFormat format, std::vector<unsigned char> &buffer)
+    {
+        if(image.format() == format && !image.mapped()) return image.row(y);
+
+        buffer.resize(image.width() * pixel_size(format));
+        if(image.format() == format)
+        {
+            image.read_row(y, buffer.data());
+            return buffer.data();
+        }
+
+        std::vector<Vector3d> line(image.width());
+        image.load(0, y, line.data(), image.width());
+        convert_pixels(line.data(), line.size(), format, buffer.data());
+        return buffer.data();
+    }
+
+    void write_pfm(const Image &image, const std::string &file)
+    {
+        std::ofstream out = open_output(file);
+
+        //a negative scale marks little endian data
+        std::string header = "PF\n" + std::to_string(image.width()) + " " + std::to_string(image.height()) + "\n";
+        header += little_endian() ? "-1.0\n" : "1.0\n";
+        out.write(header.data(), header.size());
+
+        std::vector<unsigned char> buffer;
+        size_t row_size = image.width() * pixel_size(PixelFormat::RGB_FLOAT);
+        for(size_t y = image.height(); y-- > 0;)
+            out.write((const char*)row_as(image, y, PixelFormat::RGB_FLOAT, buffer), row_size);
+
+        out.close();
+        if(out.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to write " + file);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    // OpenEXR
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template<class T>
+    static void put(std::vector<unsigned char> &out, T value)
+    {
+        unsigned char bytes[sizeof(T)];
+        memcpy(bytes, &value, sizeof(T));
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    static void attribute(std::vector<unsigned char> &out, const std::string &name, const std::string &type, const std::vector<unsigned char> &value)
+    {
+        out.insert(out.end(), name.begin(), name.end());
+        out.push_back(0);
+        out.insert(out.end(), type.begin(), type.end());
+        out.push_back(0);
+        put<int32_t>(out, value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    /*
+        Layout: magic, version, header attributes, offset table (one line per chunk), then per line
+        its y, the data size and the line's pixels per channel. Channels are sorted by name (B, G, R).
+    */
+    void write_exr(const Image &image, const std::string &file)
+    {
+        if(!little_endian()) throw Exception(__PRETTY_FUNCTION__, "exr output needs a little endian host");
+
+        const size_t w = image.width(), h = image.height();
+        const bool half = image.format() == PixelFormat::RGB_HALF || image.format() == PixelFormat::RGB_8;
+        const PixelFormat format = half ? PixelFormat::RGB_HALF : PixelFormat::RGB_FLOAT;
+        const size_t channel_size = half ? 2 : 4;
+
+        std::vector<unsigned char> header, value;
+        put<uint32_t>(header, 20000630); //magic
+        put<uint32_t>(header, 2); //version 2, single part scanline
+
+        for(const char *name : { "B", "G", "R" })
+        {
+            value.push_back(name[0]);
+            value.push_back(0);
+            put<int32_t>(value, half ? 1 : 2); //pixel type
+            put<uint32_t>(value, 0); //pLinear and reserved
+            put<int32_t>(value, 1); //x sampling
+            put<int32_t>(value, 1); //y sampling
+        }
+        value.push_back(0);
+        attribute(header, "channels", "chlist", value);
+
+        attribute(header, "compression", "compression", { 0 }); //none
+        value.clear();
+        put<int32_t>(value, 0); put<int32_t>(value, 0); put<int32_t>(value, w - 1); put<int32_t>(value, h - 1);
+        attribute(header, "dataWindow", "box2i", value);
+        attribute(header, "displayWindow", "box2i", value);
+        attribute(header, "lineOrder", "lineOrder", { 0 }); //increasing y
+        value.clear(); put<float>(value, 1.0f);
+        attribute(header, "pixelAspectRatio", "float", value);
+        value.clear(); put<float>(value, 0.0f); put<float>(value, 0.0f);
+        attribute(header, "screenWindowCenter", "v2f", value);
+        value.clear(); put<float>(value, 1.0f);
+        attribute(header, "screenWindowWidth", "float", value);
+        header.push_back(0);
+
+        //every line is a chunk of y, size and the data
+        const size_t line_size = w * 3 * channel_size;
+        uint64_t offset = header.size() + h * sizeof(uint64_t);
+        for(size_t y = 0; y < h; ++y, offset += 8 + line_size) put<uint64_t>(header, offset);
+
+        std::ofstream out = open_output(file);
+        out.write((const char*)header.data(), header.size());
+
+        std::vector<unsigned char> buffer, line(8 + line_size);
+        for(size_t y = 0; y < h; ++y)
+        {
+            int32_t chunk[2] = { int32_t(y), int32_t(line_size) };
+            memcpy(line.data(), chunk, 8);
+
+            //interleaved rgb to one plane per channel
+            const unsigned char *pixels = (const unsigned char*)row_as(image, y, format, buffer);
+            for(size_t c = 0; c < 3; ++c)
+            {
+                unsigned char *plane = &line[8 + c * w * channel_size];
+                size_t channel = 2 - c; //b, g, r
+                for(size_t x = 0; x < w; ++x)
+                    memcpy(plane + x * channel_size, pixels + (x * 3 + channel) * channel_size, channel_size);
+            }
+            out.write((const char*)line.data(), line.size());
+        }
+
+        out.close();
+        if(out.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to write " + file);
+    }
+
+}
@@ -0,0 +1,25 @@
+#ifndef DATA_HDRWRITER_HPP
+#define DATA_HDRWRITER_HPP
+
+#include "image.hpp"
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        Float output without clamping or compression, for compositing. Both write rows straight
+        from the image memory when it is stored in the file's pixel type (RGB_FLOAT for pfm,
+        RGB_FLOAT or RGB_HALF for exr), other formats are converted a row at a time.
+    */
+
+    //portable float map, rgb floats in host byte order, rows bottom to top.
+    void write_pfm(const Image &image, const std::string &file);
+
+    //uncompressed single part scanline OpenEXR with half channels for RGB_HALF and RGB_8 images
+    //and float channels otherwise. Little endian hosts only.
+    void write_exr(const Image &image, const std::string &file);
+
+}
+
+#endif
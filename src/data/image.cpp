@@ -1,55 +1,161 @@
 #include "image.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "pngwriter.hpp"
+#include "hdrwriter.hpp"
 #include "../lib/lodepng.hpp"
 
 namespace data
 {
 
     Image::Image(std::string file)
+        : m_format(PixelFormat::RGB_DOUBLE), m_pixels(nullptr), m_data(nullptr), m_mapped_size(0), m_keep_file(false)
     {
         read_from_file(file);
     }
 
-    Image::Image(size_t w, size_t h)
+    Image::Image(size_t w, size_t h, PixelFormat format)
     {
+        if(!storable(format))
+            throw Exception(__PRETTY_FUNCTION__, "images can not be stored as " + format_name(format));
+
         m_width = w;
         m_height = h;
+        m_format = format;
         m_pixels = nullptr;
+        m_data = nullptr;
+        m_mapped_size = 0;
+        m_keep_file = false;
         allocate_data();
     }
 
+    Image::Image(size_t w, size_t h, PixelFormat format, const std::string &file, bool keep_file)
+        : m_width(w), m_height(h), m_format(format), m_pixels(nullptr), m_data(nullptr), m_mapped_size(0),
+          m_file(file), m_keep_file(keep_file)
+    {
+        if(!storable(format))
+            throw Exception(__PRETTY_FUNCTION__, "images can not be stored as " + format_name(format));
+        map_file();
+    }
+
     Image::~Image()
     {
-        if(m_pixels) delete[] m_pixels;
+        free_data();
     }
 
     size_t Image::width() const { return m_width; }
     size_t Image::height() const { return m_height; }
+    PixelFormat Image::format() const { return m_format; }
+    bool Image::mapped() const { return m_mapped_size != 0; }
 
-    const Vector3d& Image::color_at(double x, double y) const
+    Vector3d Image::color_at(double x, double y) const
     {
-        return m_pixels[index(x, y)];
+        size_t i = index(x, y);
+        return get_pixel(i % m_width, i / m_width);
     }
 
     Vector3d Image::get_pixel(size_t x, size_t y) const
     {
-        return m_pixels[index(x, y)];
+        if(m_pixels) return m_pixels[index(x, y)];
+
+        Vector3d rval;
+        convert_pixels(m_data + offset(x, y), 1, m_format, &rval);
+        return rval;
     }
 
     void Image::set_pixel(const Vector3d &color, size_t x, size_t y)
     {
-        m_pixels[index(x, y)] = color;
+        if(m_pixels) m_pixels[index(x, y)] = color;
+        else convert_pixels(&color, 1, m_format, m_data + offset(x, y));
     }
 
     Vector3d& Image::operator()(size_t x, size_t y)
     {
+        if(mapped()) throw Exception(__PRETTY_FUNCTION__, "mapped images have no pixel references");
+        if(!m_pixels) throw Exception(__PRETTY_FUNCTION__, "pixel references need rgb double storage");
         return m_pixels[index(x, y)];
     }
 
     const Vector3d& Image::operator()(size_t x, size_t y) const
     {
+        if(mapped()) throw Exception(__PRETTY_FUNCTION__, "mapped images have no pixel references");
+        if(!m_pixels) throw Exception(__PRETTY_FUNCTION__, "pixel references need rgb double storage");
         return m_pixels[index(x, y)];
     }
 
+    //spans of mapped images are split at the tile borders, within a tile rows are contiguous.
+    void Image::load(size_t x, size_t y, Vector3d *pixels, size_t count) const
+    {
+        if(m_pixels) { std::copy(m_pixels + index(x, y), m_pixels + index(x, y) + count, pixels); return; }
+
+        while(count > 0)
+        {
+            size_t n = mapped() ? std::min(count, tile_size - x % tile_size) : count;
+            convert_pixels(m_data + offset(x, y), n, m_format, pixels);
+            x += n; pixels += n; count -= n;
+        }
+    }
+
+    void Image::store(size_t x, size_t y, const Vector3d *pixels, size_t count)
+    {
+        if(m_pixels) { std::copy(pixels, pixels + count, m_pixels + index(x, y)); return; }
+
+        while(count > 0)
+        {
+            size_t n = mapped() ? std::min(count, tile_size - x % tile_size) : count;
+            convert_pixels(pixels, n, m_format, m_data + offset(x, y));
+            x += n; pixels += n; count -= n;
+        }
+    }
+
+    const void* Image::row(size_t y) const
+    {
+        if(mapped()) throw Exception(__PRETTY_FUNCTION__, "rows of mapped images are not contiguous");
+        if(m_pixels) return m_pixels + index(size_t(0), y);
+        return m_data + offset(0, y);
+    }
+
+    void Image::read_row(size_t y, void *out) const
+    {
+        if(m_pixels) { convert_pixels(m_pixels + index(size_t(0), y), m_width, m_format, out); return; }
+
+        size_t ps = pixel_size(m_format);
+        size_t step = mapped() ? tile_size : m_width;
+        for(size_t x = 0; x < m_width; x += step)
+            memcpy((unsigned char*)out + x * ps, m_data + offset(x, y), std::min(step, m_width - x) * ps);
+    }
+
+    bool Image::storable(PixelFormat format)
+    {
+        return format == PixelFormat::RGB_DOUBLE || format == PixelFormat::RGB_FLOAT
+            || format == PixelFormat::RGB_HALF || format == PixelFormat::RGB_8;
+    }
+
+    void Image::convert(PixelFormat format)
+    {
+        if(format == m_format) return;
+        if(mapped()) throw Exception(__PRETTY_FUNCTION__, "mapped images can not be converted");
+
+        Image converted(m_width, m_height, format);
+        std::vector<Vector3d> line(m_width);
+        for(size_t y = 0; y < m_height; ++y)
+        {
+            load(0, y, line.data(), m_width);
+            converted.store(0, y, line.data(), m_width);
+        }
+
+        free_data();
+        m_format = format;
+        m_pixels = converted.m_pixels;
+        m_data = converted.m_data;
+        converted.m_pixels = nullptr;
+        converted.m_data = nullptr;
+    }
+
     void Image::read_from_file(std::string file)
     {
         unsigned int width, height;
@@ -60,6 +166,7 @@ namespace data
 
         m_width = width;
         m_height = height;
+        m_format = PixelFormat::RGB_DOUBLE;
         allocate_data();
 
         auto it = image.begin();
@@ -75,36 +182,103 @@ namespace data
         }
     }
 
-    void Image::write_to_file(std::string file) const
+    //streamed row by row, no full size byte copy of the image is made.
+    void Image::write_to_file(std::string file, size_t thread_count, const Quantizer &quantizer) const
     {
-        std::vector<unsigned char> image;
-        image.reserve(m_width * m_height * 4);
-        
+        auto extension = [&file](const std::string &ext)
+        {
+            return file.size() >= ext.size() && file.compare(file.size() - ext.size(), ext.size(), ext) == 0;
+        };
+
+        if(extension(".pfm")) { write_pfm(*this, file); return; }
+        if(extension(".exr")) { write_exr(*this, file); return; }
+        if(thread_count > 1) { write_png(*this, file, thread_count, quantizer); return; }
+
+        PngWriter writer(file, m_width, m_height);
+        writer.quantizer(quantizer);
+        std::vector<Vector3d> line(m_width);
+        std::vector<unsigned char> rgb(m_format == PixelFormat::RGB_8 ? m_width * 3 : 0);
+
         for(size_t h = 0; h < m_height; ++h)
-            for(size_t w = 0; w < m_width; ++w)
+        {
+            //8 bit images are already quantized, written as is
+            if(m_format == PixelFormat::RGB_8)
             {
-                image.push_back((unsigned char)(m_pixels[index(w, h)].m_x * 255.0));
-                image.push_back((unsigned char)(m_pixels[index(w, h)].m_y * 255.0));
-                image.push_back((unsigned char)(m_pixels[index(w, h)].m_z * 255.0));
-                image.push_back(255);
+                read_row(h, rgb.data());
+                writer.write_row(rgb.data());
             }
-
-        unsigned int error = lodepng::encode(file, image.data(), m_width, m_height);
-        if(error != 0) throw Exception(__PRETTY_FUNCTION__, "failed to write image - " + std::string(lodepng_error_text(error)));
+            else
+            {
+                load(0, h, line.data(), m_width);
+                writer.write_row(line.data());
+            }
+        }
+        writer.finish();
     }
 
     std::string Image::to_string() const
     {
         std::string s = "data::Image - dimensions [";
         s += std::to_string(m_width) + ",";
-        s += std::to_string(m_height) + "]";
+        s += std::to_string(m_height) + "] ";
+        s += format_name(m_format);
+        if(mapped()) s += " mapped to " + m_file;
         return s;
     }
 
     void Image::allocate_data()
+    {
+        free_data();
+        if(m_format == PixelFormat::RGB_DOUBLE) m_pixels = new Vector3d[m_width * m_height];
+        else m_data = new unsigned char[m_width * m_height * pixel_size(m_format)]();
+    }
+
+    void Image::map_file()
+    {
+        size_t tiles_x = (m_width + tile_size - 1) / tile_size;
+        size_t tiles_y = (m_height + tile_size - 1) / tile_size;
+        size_t size = tiles_x * tiles_y * tile_size * tile_size * pixel_size(m_format);
+        if(size == 0) throw Exception(__PRETTY_FUNCTION__, "mapped images can not be empty");
+
+        int fd = open(m_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "failed to open " + m_file + " - " + std::string(strerror(errno)));
+
+        //sparse file, blocks are only allocated once written
+        if(ftruncate(fd, size) != 0)
+        {
+            std::string error = strerror(errno);
+            close(fd);
+            throw Exception(__PRETTY_FUNCTION__, "failed to size " + m_file + " - " + error);
+        }
+
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        std::string error = strerror(errno);
+        close(fd);
+        if(memory == MAP_FAILED) throw Exception(__PRETTY_FUNCTION__, "mmap failed - " + error);
+
+        if(!m_keep_file) unlink(m_file.c_str()); //lives on until unmapped
+        m_data = (unsigned char*)memory;
+        m_mapped_size = size;
+    }
+
+    void Image::free_data()
     {
         if(m_pixels) delete[] m_pixels;
-        m_pixels = new Vector3d[m_width * m_height];
+        if(m_data && m_mapped_size) munmap(m_data, m_mapped_size);
+        else if(m_data) delete[] m_data;
+        m_pixels = nullptr;
+        m_data = nullptr;
+        m_mapped_size = 0;
+    }
+
+    size_t Image::offset(size_t x, size_t y) const
+    {
+        if(!mapped()) return index(x, y) * pixel_size(m_format);
+
+        size_t tiles_x = (m_width + tile_size - 1) / tile_size;
+        size_t tile = (y / tile_size) * tiles_x + (x / tile_size);
+        size_t within = (y % tile_size) * tile_size + (x % tile_size);
+        return (tile * tile_size * tile_size + within) * pixel_size(m_format);
     }
 
     size_t Image::index(size_t x, size_t y) const
@@ -119,4 +293,4 @@ namespace data
         return index(sx, sy);
     }
 
-}
\ No newline at end of file
+}
@@ -2,24 +2,41 @@
 #define DATA_IMAGE_HPP
 
 #include "../core.hpp"
+#include "quantizer.hpp"
+#include "pixelformat.hpp"
 
 namespace data 
 {
 
+    /*
+        Pixels are stored as Vector3d (RGB_DOUBLE, the default) or in a compact format: RGB_FLOAT,
+        RGB_HALF or RGB_8 for final output. References to pixels (operator()) are only available
+        for RGB_DOUBLE images, other formats convert on every access, use load/store for rows.
+
+        Images too large for memory can be stored in a memory mapped file instead, laid out in
+        tiles of tile_size x tile_size pixels so a render tile touches few pages. The OS pages the
+        file in and out, so the image size is bounded by disk space. Mapped images have no pixel
+        references and no contiguous rows (row), files are removed on destruction unless kept.
+    */
+
     class Image : public Object
     {
     public:
         Image(std::string file);
-        Image(size_t w = 0, size_t h = 0);
+        Image(size_t w = 0, size_t h = 0, PixelFormat format = PixelFormat::RGB_DOUBLE);
+        Image(size_t w, size_t h, PixelFormat format, const std::string &file, bool keep_file = false);
         Image(const Image&) = delete;
         virtual ~Image();
 
         //simple getters
         size_t width() const;
         size_t height() const;
+        PixelFormat format() const;
+        bool mapped() const;
+        static const size_t tile_size = 64; //of mapped images, tiles are whole pages in every format
 
         //normalized access (between 0-1)
-        const Vector3d& color_at(double x, double y) const;
+        Vector3d color_at(double x, double y) const;
 
         //other accessors
         Vector3d get_pixel(size_t x, size_t y) const;
@@ -27,22 +44,41 @@ namespace data
         Vector3d& operator()(size_t x, size_t y);
         const Vector3d& operator()(size_t x, size_t y) const;
 
+        //bulk access to count pixels of row y starting at x.
+        void load(size_t x, size_t y, Vector3d *pixels, size_t count) const;
+        void store(size_t x, size_t y, const Vector3d *pixels, size_t count);
+        const void* row(size_t y) const; //raw row in the storage format, not for mapped images
+        void read_row(size_t y, void *out) const; //copies a raw row, for every image
+
+        static bool storable(PixelFormat format); //whether images can use format
+        //converts the pixel storage, 8 bit formats lose everything outside 0-1.
+        void convert(PixelFormat format);
+
         //read/write from/to file
         void read_from_file(std::string file);
-        void write_to_file(std::string file) const;
+        //png (compressed on thread_count threads), or pfm and exr float output by extension.
+        void write_to_file(std::string file, size_t thread_count = 1, const Quantizer &quantizer = Quantizer()) const;
 
         virtual std::string to_string() const;
 
     protected:
         size_t m_width;
         size_t m_height;
-        Vector3d *m_pixels;
+        PixelFormat m_format;
+        Vector3d *m_pixels; //RGB_DOUBLE storage
+        unsigned char *m_data; //storage of the other formats, or the mapping
+        size_t m_mapped_size; //0 for images in memory
+        std::string m_file;
+        bool m_keep_file;
 
         void allocate_data();
+        void map_file();
+        void free_data();
+        size_t offset(size_t x, size_t y) const; //of the pixel in m_data, in bytes
         size_t index(size_t x, size_t y) const;
         size_t index(double x, double y) const;
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,74 @@
+#include "imagewriter.hpp"
+
+namespace data
+{
+
+    ImageWriter::ImageWriter(size_t queue_size)
+        : m_queue_size(queue_size == 0 ? 1 : queue_size), m_stop(false), m_busy(false)
+    {
+        m_thread = std::thread(&ImageWriter::run, this);
+    }
+
+    ImageWriter::~ImageWriter()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stop = true;
+        }
+        m_changed.notify_all();
+        m_thread.join();
+    }
+
+    std::future<void> ImageWriter::write(Image *image, const std::string &file)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_changed.wait(lock, [this]() { return m_queue.size() < m_queue_size; });
+
+        m_queue.push_back(Job{ image, file, std::promise<void>() });
+        std::future<void> rval = m_queue.back().promise.get_future();
+
+        lock.unlock();
+        m_changed.notify_all();
+        return rval;
+    }
+
+    void ImageWriter::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_changed.wait(lock, [this]() { return m_queue.empty() && !m_busy; });
+    }
+
+    std::string ImageWriter::to_string() const
+    {
+        return "data::ImageWriter - queue size " + std::to_string(m_queue_size);
+    }
+
+    void ImageWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        while(true)
+        {
+            m_changed.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if(m_queue.empty()) break; //stopped and drained
+
+            Job job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+            m_changed.notify_all(); //room in the queue
+
+            try
+            {
+                job.image->write_to_file(job.file);
+                job.promise.set_value();
+            }
+            catch(...) { job.promise.set_exception(std::current_exception()); }
+            delete job.image;
+
+            lock.lock();
+            m_busy = false;
+            m_changed.notify_all();
+        }
+    }
+
+}
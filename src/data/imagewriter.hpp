@@ -0,0 +1,56 @@
+#ifndef DATA_IMAGEWRITER_HPP
+#define DATA_IMAGEWRITER_HPP
+
+#include <deque>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <condition_variable>
+
+#include "image.hpp"
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        Encodes images to file on a background thread so rendering can continue.
+        write takes ownership of the image and deletes it once written, the returned future
+        reports completion (or rethrows the encoding exception). At most queue_size images wait
+        to be encoded, write blocks until there is room again.
+    */
+
+    class ImageWriter : public Object
+    {
+    public:
+        ImageWriter(size_t queue_size = 2);
+        ImageWriter(const ImageWriter&) = delete;
+        virtual ~ImageWriter(); //finishes all queued images.
+
+        std::future<void> write(Image *image, const std::string &file);
+        void wait(); //blocks until the queue is empty.
+
+        virtual std::string to_string() const;
+
+    protected:
+        struct Job
+        {
+            Image *image;
+            std::string file;
+            std::promise<void> promise;
+        };
+
+        size_t m_queue_size;
+        bool m_stop;
+        bool m_busy;
+        std::deque<Job> m_queue;
+        std::mutex m_lock;
+        std::condition_variable m_changed;
+        std::thread m_thread;
+
+        void run();
+    };
+
+}
+
+#endif
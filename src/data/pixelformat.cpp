@@ -0,0 +1,206 @@
+#include "pixelformat.hpp"
+
+#include <cstring>
+
+namespace data
+{
+
+    size_t pixel_size(PixelFormat format)
+    {
+        switch(format)
+        {
+            case PixelFormat::RGB_DOUBLE: return 3 * sizeof(double);
+            case PixelFormat::RGB_FLOAT: return 3 * sizeof(float);
+            case PixelFormat::RGB_8: return 3;
+            case PixelFormat::RGBA_8: return 4;
+            case PixelFormat::BGRA_8: return 4;
+            case PixelFormat::RGB_HALF: return 3 * sizeof(uint16_t);
+        }
+        throw Exception(__PRETTY_FUNCTION__, "unknown pixel format");
+    }
+
+    std::string format_name(PixelFormat format)
+    {
+        switch(format)
+        {
+            case PixelFormat::RGB_DOUBLE: return "rgb double";
+            case PixelFormat::RGB_FLOAT: return "rgb float";
+            case PixelFormat::RGB_8: return "rgb 8";
+            case PixelFormat::RGBA_8: return "rgba 8";
+            case PixelFormat::BGRA_8: return "bgra 8";
+            case PixelFormat::RGB_HALF: return "rgb half";
+        }
+        return "unknown";
+    }
+
+    uint16_t float_to_half(float f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+
+        uint16_t sign = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if(exponent == 0xFF) return sign | 0x7C00 | (mantissa ? 0x200 : 0); //inf and nan
+        int e = int(exponent) - 127 + 15;
+        if(e >= 31) return sign | 0x7C00;
+
+        if(e <= 0)
+        {
+            //subnormal (or zero) half
+            if(e < -10) return sign;
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - e;
+            uint32_t half = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if(rest > halfway || (rest == halfway && (half & 1))) ++half;
+            return sign | half;
+        }
+
+        uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1FFF;
+        if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half; //may carry into the exponent, which is correct
+        return sign | half;
+    }
+
+    float half_to_float(uint16_t h)
+    {
+        uint32_t sign = uint32_t(h & 0x8000) << 16;
+        uint32_t exponent = (h >> 10) & 0x1F;
+        uint32_t mantissa = h & 0x3FF;
+        uint32_t bits;
+
+        if(exponent == 0x1F) bits = sign | 0x7F800000 | (mantissa << 13);
+        else if(exponent != 0) bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        else if(mantissa == 0) bits = sign;
+        else
+        {
+            //subnormal half, normalize it
+            exponent = 127 - 15 + 1;
+            while(!(mantissa & 0x400)) { mantissa <<= 1; --exponent; }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    static inline unsigned char to_byte(double d)
+    {
+        if(d <= 0.0) return 0;
+        if(d >= 1.0) return 255;
+        return (unsigned char)(d * 255.0 + 0.5);
+    }
+
+    void convert_pixels(const Vector3d *src, size_t count, PixelFormat format, void *dst)
+    {
+        switch(format)
+        {
+            case PixelFormat::RGB_DOUBLE:
+            {
+                double *out = (double*)dst;
+                for(size_t i = 0; i < count; ++i, out += 3)
+                {
+                    out[0] = src[i].m_x;
+                    out[1] = src[i].m_y;
+                    out[2] = src[i].m_z;
+                }
+                return;
+            }
+            case PixelFormat::RGB_FLOAT:
+            {
+                float *out = (float*)dst;
+                for(size_t i = 0; i < count; ++i, out += 3)
+                {
+                    out[0] = src[i].m_x;
+                    out[1] = src[i].m_y;
+                    out[2] = src[i].m_z;
+                }
+                return;
+            }
+            case PixelFormat::RGB_8:
+            {
+                unsigned char *out = (unsigned char*)dst;
+                for(size_t i = 0; i < count; ++i, out += 3)
+                {
+                    out[0] = to_byte(src[i].m_x);
+                    out[1] = to_byte(src[i].m_y);
+                    out[2] = to_byte(src[i].m_z);
+                }
+                return;
+            }
+            case PixelFormat::RGBA_8:
+            case PixelFormat::BGRA_8:
+            {
+                bool bgr = format == PixelFormat::BGRA_8;
+                unsigned char *out = (unsigned char*)dst;
+                for(size_t i = 0; i < count; ++i, out += 4)
+                {
+                    out[bgr ? 2 : 0] = to_byte(src[i].m_x);
+                    out[1] = to_byte(src[i].m_y);
+                    out[bgr ? 0 : 2] = to_byte(src[i].m_z);
+                    out[3] = 255;
+                }
+                return;
+            }
+            case PixelFormat::RGB_HALF:
+            {
+                uint16_t *out = (uint16_t*)dst;
+                for(size_t i = 0; i < count; ++i, out += 3)
+                {
+                    out[0] = float_to_half(src[i].m_x);
+                    out[1] = float_to_half(src[i].m_y);
+                    out[2] = float_to_half(src[i].m_z);
+                }
+                return;
+            }
+        }
+        throw Exception(__PRETTY_FUNCTION__, "unknown pixel format");
+    }
+
+    void convert_pixels(const void *src, size_t count, PixelFormat format, Vector3d *dst)
+    {
+        switch(format)
+        {
+            case PixelFormat::RGB_DOUBLE:
+            {
+                const double *in = (const double*)src;
+                for(size_t i = 0; i < count; ++i, in += 3) dst[i] = Vector3d(in[0], in[1], in[2]);
+                return;
+            }
+            case PixelFormat::RGB_FLOAT:
+            {
+                const float *in = (const float*)src;
+                for(size_t i = 0; i < count; ++i, in += 3) dst[i] = Vector3d(in[0], in[1], in[2]);
+                return;
+            }
+            case PixelFormat::RGB_8:
+            {
+                const unsigned char *in = (const unsigned char*)src;
+                for(size_t i = 0; i < count; ++i, in += 3) dst[i] = Vector3d(in[0] / 255.0, in[1] / 255.0, in[2] / 255.0);
+                return;
+            }
+            case PixelFormat::RGBA_8:
+            case PixelFormat::BGRA_8:
+            {
+                bool bgr = format == PixelFormat::BGRA_8;
+                const unsigned char *in = (const unsigned char*)src;
+                for(size_t i = 0; i < count; ++i, in += 4)
+                    dst[i] = Vector3d(in[bgr ? 2 : 0] / 255.0, in[1] / 255.0, in[bgr ? 0 : 2] / 255.0);
+                return;
+            }
+            case PixelFormat::RGB_HALF:
+            {
+                const uint16_t *in = (const uint16_t*)src;
+                for(size_t i = 0; i < count; ++i, in += 3)
+                    dst[i] = Vector3d(half_to_float(in[0]), half_to_float(in[1]), half_to_float(in[2]));
+                return;
+            }
+        }
+        throw Exception(__PRETTY_FUNCTION__, "unknown pixel format");
+    }
+
+}
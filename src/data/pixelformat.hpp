@@ -0,0 +1,39 @@
+#ifndef DATA_PIXELFORMAT_HPP
+#define DATA_PIXELFORMAT_HPP
+
+#include <cstdint>
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        Memory layouts pixels can be stored in. The renderer's colors are display (sRGB) values
+        between 0 and 1, the 8 bit formats hold them quantized to 0-255 without further encoding.
+        RGB_HALF stores IEEE 754 half floats.
+    */
+    enum class PixelFormat : uint32_t
+    {
+        RGB_DOUBLE = 0,
+        RGB_FLOAT = 1,
+        RGB_8 = 2,
+        RGBA_8 = 3,
+        BGRA_8 = 4,
+        RGB_HALF = 5
+    };
+
+    size_t pixel_size(PixelFormat format); //bytes per pixel
+    std::string format_name(PixelFormat format);
+
+    //converts count pixels into dst, which is laid out as format.
+    void convert_pixels(const Vector3d *src, size_t count, PixelFormat format, void *dst);
+    //and back, src is laid out as format.
+    void convert_pixels(const void *src, size_t count, PixelFormat format, Vector3d *dst);
+
+    //half float conversions (round to nearest even, overflow becomes infinity).
+    uint16_t float_to_half(float f);
+    float half_to_float(uint16_t h);
+
+}
+
+#endif
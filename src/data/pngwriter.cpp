@@ -0,0 +1,397 @@
+#include "pngwriter.hpp"
+
+#include <thread>
+#include <cstdlib>
+#include <condition_variable>
+#include "../lib/lodepng.hpp"
+
+namespace data
+{
+
+    static void put32(unsigned char *out, uint32_t value)
+    {
+        out[0] = (value >> 24) & 0xFF;
+        out[1] = (value >> 16) & 0xFF;
+        out[2] = (value >> 8) & 0xFF;
+        out[3] = value & 0xFF;
+    }
+
+    PngWriter::PngWriter(const std::string &file, size_t w, size_t h, size_t flush_size)
+        : m_file(file), m_width(w), m_height(h), m_flush_size(flush_size), m_rows(0), m_finished(false), m_zlib_header(false),
+          m_previous(w * 3, 0), m_adler(1), m_completed_rows(0), m_writing(false)
+    {
+        if(w == 0 || h == 0) throw Exception(__PRETTY_FUNCTION__, "png dimensions can not be 0");
+
+        m_out.open(file, std::ios::binary | std::ios::trunc);
+        if(m_out.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to open " + file);
+
+        static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        m_out.write((const char*)signature, 8);
+
+        unsigned char header[13];
+        put32(header, w);
+        put32(header + 4, h);
+        header[8] = 8;  //bit depth
+        header[9] = 2;  //rgb
+        header[10] = 0; //deflate
+        header[11] = 0; //adaptive filtering
+        header[12] = 0; //no interlacing
+        write_chunk("IHDR", header, 13);
+
+        m_filtered.reserve(m_flush_size + 1 + w * 3);
+    }
+
+    PngWriter::~PngWriter() { }
+
+    size_t PngWriter::width() const { return m_width; }
+    size_t PngWriter::height() const { return m_height; }
+    size_t PngWriter::rows_written() const { return m_rows; }
+    void PngWriter::quantizer(const Quantizer &q) { m_quantizer = q; }
+
+    void PngWriter::write_row(const Vector3d *pixels)
+    {
+        static thread_local std::vector<unsigned char> rgb;
+        rgb.resize(m_width * 3);
+        m_quantizer.quantize(pixels, m_width, 0, m_rows, rgb.data());
+        write_row(rgb.data());
+    }
+
+    void PngWriter::write_row(const unsigned char *rgb)
+    {
+        if(m_rows >= m_height) throw Exception(__PRETTY_FUNCTION__, "all rows are already written");
+
+        filter_row(rgb);
+        ++m_rows;
+        if(m_filtered.size() >= m_flush_size || m_rows == m_height) deflate_filtered();
+    }
+
+    void PngWriter::store(size_t x, size_t y, const Vector3d *pixels, size_t count)
+    {
+        if(y >= m_height || x + count > m_width) throw Exception(__PRETTY_FUNCTION__, "pixels outside the image");
+
+        static thread_local std::vector<unsigned char> rgb;
+        rgb.resize(count * 3);
+        m_quantizer.quantize(pixels, count, x, y, rgb.data());
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if(y < m_completed_rows) throw Exception(__PRETTY_FUNCTION__, "row " + std::to_string(y) + " is already written");
+
+            PendingRow &row = m_pending[y];
+            if(row.rgb.empty()) { row.rgb.resize(m_width * 3); row.filled = 0; }
+            std::copy(rgb.begin(), rgb.end(), row.rgb.begin() + x * 3);
+            row.filled += count;
+
+            //every complete row directly below the completed ones is ready to be written
+            auto it = m_pending.begin();
+            while(it != m_pending.end() && it->first == m_completed_rows && it->second.filled >= m_width)
+            {
+                m_ready.push_back(std::move(it->second.rgb));
+                it = m_pending.erase(it);
+                ++m_completed_rows;
+            }
+
+            if(m_writing || m_ready.empty()) return;
+            m_writing = true;
+        }
+
+        //filter and deflate outside the lock, until no rows are left
+        std::deque<std::vector<unsigned char>> ready;
+        try
+        {
+            while(true)
+            {
+                {
+                    std::lock_guard<std::mutex> guard(m_lock);
+                    if(m_ready.empty()) { m_writing = false; return; }
+                    ready.swap(m_ready);
+                }
+
+                for(const std::vector<unsigned char> &row : ready) write_row(row.data());
+                ready.clear();
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_writing = false;
+            throw;
+        }
+    }
+
+    void PngWriter::finish()
+    {
+        if(m_finished) return;
+        if(m_rows != m_height) throw Exception(__PRETTY_FUNCTION__, "only " + std::to_string(m_rows) + " of " + std::to_string(m_height) + " rows written");
+
+        //final empty stored block, then the adler32 of all filtered data
+        unsigned char end[9] = { 1, 0, 0, 0xFF, 0xFF };
+        put32(end + 5, m_adler);
+        write_chunk("IDAT", end, 9);
+        write_chunk("IEND", nullptr, 0);
+
+        m_out.close();
+        if(m_out.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to write " + m_file);
+        m_finished = true;
+    }
+
+    void PngWriter::filter_row(const unsigned char *rgb)
+    {
+        png_filter_row(rgb, m_previous.data(), m_width * 3, m_filtered);
+        std::copy(rgb, rgb + m_width * 3, m_previous.begin());
+    }
+
+    void PngWriter::deflate_filtered()
+    {
+        if(m_filtered.empty()) return;
+
+        std::vector<unsigned char> deflated = png_deflate(m_filtered);
+        uint32_t adler = adler32(1, m_filtered.data(), m_filtered.size());
+        size_t length = m_filtered.size();
+
+        m_filtered.clear();
+        write_deflated(deflated, adler, length, 0);
+    }
+
+    void PngWriter::write_deflated(const std::vector<unsigned char> &deflated, uint32_t adler, size_t length, size_t rows)
+    {
+        if(!m_filtered.empty()) throw Exception(__PRETTY_FUNCTION__, "rows are still waiting to be deflated");
+
+        m_rows += rows;
+        m_adler = adler32_combine(m_adler, adler, length);
+
+        //the first IDAT starts with the zlib header: deflate with a 32k window, no dictionary
+        if(!m_zlib_header)
+        {
+            std::vector<unsigned char> data = { 0x78, 0x01 };
+            data.insert(data.end(), deflated.begin(), deflated.end());
+            write_chunk("IDAT", data.data(), data.size());
+            m_zlib_header = true;
+        }
+        else write_chunk("IDAT", deflated.data(), deflated.size());
+    }
+
+    void PngWriter::write_chunk(const char *type, const unsigned char *data, size_t size)
+    {
+        //the crc covers the type and data
+        std::vector<unsigned char> chunk(type, type + 4);
+        chunk.insert(chunk.end(), data, data + size);
+
+        unsigned char length[4], crc[4];
+        put32(length, size);
+        put32(crc, lodepng_crc32(chunk.data(), chunk.size()));
+
+        m_out.write((const char*)length, 4);
+        m_out.write((const char*)chunk.data(), chunk.size());
+        m_out.write((const char*)crc, 4);
+    }
+
+    std::string PngWriter::to_string() const
+    {
+        return "data::PngWriter " + m_file + " - dimensions [" + std::to_string(m_width) + ","
+            + std::to_string(m_height) + "] " + std::to_string(m_rows) + " rows written";
+    }
+
+    /*
+        Picks the filter with the smallest sum of absolute (signed) values, the heuristic
+        recommended by the png specification and used by lodepng.
+    */
+    void png_filter_row(const unsigned char *rgb, const unsigned char *up, size_t n, std::vector<unsigned char> &out)
+    {
+        static thread_local std::vector<unsigned char> candidates[5];
+
+        size_t best = 0, best_sum = size_t(-1);
+        for(size_t f = 0; f < 5; ++f)
+        {
+            std::vector<unsigned char> &filtered = candidates[f];
+            filtered.resize(n);
+            size_t sum = 0;
+
+            for(size_t i = 0; i < n; ++i)
+            {
+                int a = i >= 3 ? rgb[i - 3] : 0;
+                int b = up[i];
+                int c = i >= 3 ? up[i - 3] : 0;
+                int predicted = 0;
+
+                switch(f)
+                {
+                    case 1: predicted = a; break;
+                    case 2: predicted = b; break;
+                    case 3: predicted = (a + b) / 2; break;
+                    case 4:
+                    {
+                        int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                        predicted = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                        break;
+                    }
+                }
+
+                filtered[i] = (unsigned char)(rgb[i] - predicted);
+                sum += filtered[i] < 128 ? filtered[i] : 256 - filtered[i];
+            }
+
+            if(sum < best_sum) { best_sum = sum; best = f; }
+        }
+
+        out.push_back((unsigned char)best);
+        out.insert(out.end(), candidates[best].begin(), candidates[best].end());
+    }
+
+    std::vector<unsigned char> png_deflate(const std::vector<unsigned char> &filtered)
+    {
+        unsigned char *compressed = nullptr;
+        size_t size = 0;
+        LodePNGCompressSettings settings;
+        lodepng_compress_settings_init(&settings);
+
+        unsigned error = lodepng_deflate_flush(&compressed, &size, filtered.data(), filtered.size(), &settings);
+        std::vector<unsigned char> rval(compressed, compressed + size);
+        free(compressed);
+
+        if(error != 0) throw Exception(__PRETTY_FUNCTION__, "failed to compress - " + std::string(lodepng_error_text(error)));
+        return rval;
+    }
+
+    /*
+        Encodes strips of rows on thread_count threads, every strip is filtered (using the last row
+        of the strip above) and deflated on its own, ending in a sync flush. The writer stitches them
+        together in order, combining the checksums. Only a few strips per thread are in memory.
+    */
+    void write_png(const Image &image, const std::string &file, size_t thread_count, const Quantizer &quantizer)
+    {
+        const size_t w = image.width(), h = image.height();
+        const size_t strip_rows = std::max<size_t>(1, (1 << 20) / (w * 3 + 1)); //about a megabyte of filtered data
+        const size_t strip_count = (h + strip_rows - 1) / strip_rows;
+        if(thread_count == 0) thread_count = 1;
+        const size_t in_flight = thread_count * 2;
+
+        struct Strip
+        {
+            std::vector<unsigned char> deflated;
+            uint32_t adler;
+            size_t length, rows;
+            bool done;
+        };
+
+        PngWriter writer(file, w, h);
+        std::vector<Strip> strips(strip_count);
+        size_t next = 0, written = 0;
+        std::string error;
+        std::mutex lock;
+        std::condition_variable changed;
+
+        auto quantized = [&image, &quantizer, w](size_t y, std::vector<unsigned char> &rgb)
+        {
+            rgb.resize(w * 3);
+            if(image.format() == PixelFormat::RGB_8) { image.read_row(y, rgb.data()); return; }
+
+            std::vector<Vector3d> line(w);
+            image.load(0, y, line.data(), w);
+            quantizer.quantize(line.data(), w, 0, y, rgb.data());
+        };
+
+        auto work = [&]()
+        {
+            std::vector<unsigned char> previous, current, filtered;
+            while(true)
+            {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    changed.wait(guard, [&]() { return next >= strip_count || next < written + in_flight || !error.empty(); });
+                    if(next >= strip_count || !error.empty()) return;
+                    index = next++;
+                }
+
+                try
+                {
+                    size_t y0 = index * strip_rows, y1 = std::min(h, y0 + strip_rows);
+                    if(y0 == 0) previous.assign(w * 3, 0);
+                    else quantized(y0 - 1, previous);
+
+                    filtered.clear();
+                    for(size_t y = y0; y < y1; ++y)
+                    {
+                        quantized(y, current);
+                        png_filter_row(current.data(), previous.data(), w * 3, filtered);
+                        previous.swap(current);
+                    }
+
+                    Strip strip{ png_deflate(filtered), adler32(1, filtered.data(), filtered.size()), filtered.size(), y1 - y0, true };
+                    std::lock_guard<std::mutex> guard(lock);
+                    strips[index] = std::move(strip);
+                }
+                catch(const Exception &ex)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    error = ex.what();
+                }
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(size_t i = 0; i < thread_count; ++i) threads.push_back(std::thread(work));
+
+        //write the strips in order while the threads compress the next ones
+        while(true)
+        {
+            Strip strip;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return written == strip_count || strips[written].done || !error.empty(); });
+                if(written == strip_count || !error.empty()) break;
+                strip = std::move(strips[written]);
+                strips[written].done = false;
+            }
+
+            writer.write_deflated(strip.deflated, strip.adler, strip.length, strip.rows);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                ++written;
+            }
+            changed.notify_all();
+        }
+
+        for(std::thread &t : threads) t.join();
+        if(!error.empty()) throw Exception(__PRETTY_FUNCTION__, error);
+        writer.finish();
+    }
+
+    uint32_t adler32(uint32_t adler, const unsigned char *data, size_t size)
+    {
+        uint32_t a = adler & 0xFFFF, b = adler >> 16;
+        while(size > 0)
+        {
+            //5552 is the largest block that can not overflow before the modulo
+            size_t block = size < 5552 ? size : 5552;
+            size -= block;
+            for(size_t i = 0; i < block; ++i)
+            {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    //adler32 of two concatenated blocks, from the adler32 of both and the length of the second (as zlib does).
+    uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t length2)
+    {
+        const uint32_t base = 65521;
+        uint32_t rem = length2 % base;
+        uint32_t sum1 = adler1 & 0xFFFF;
+        uint32_t sum2 = (rem * sum1) % base;
+        sum1 += (adler2 & 0xFFFF) + base - 1;
+        sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+        if(sum1 >= base) sum1 -= base;
+        if(sum1 >= base) sum1 -= base;
+        if(sum2 >= (base << 1)) sum2 -= (base << 1);
+        if(sum2 >= base) sum2 -= base;
+        return sum1 | (sum2 << 16);
+    }
+
+}
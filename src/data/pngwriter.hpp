@@ -0,0 +1,94 @@
+#ifndef DATA_PNGWRITER_HPP
+#define DATA_PNGWRITER_HPP
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <fstream>
+
+#include "image.hpp"
+#include "quantizer.hpp"
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        Writes an 8 bit rgb png while the rows come in, so only a few rows are in memory at any time.
+        Rows are filtered, collected until flush_size bytes and deflated into their own IDAT chunk.
+        write_row takes the rows in order, store takes pixels in any order (from several threads) and
+        keeps the incomplete rows until every row above them is written. store only locks to copy the
+        quantized pixels, one storing thread at a time filters and deflates the completed rows while
+        the others carry on. finish must be called after the last row, an unfinished file is left incomplete.
+    */
+
+    class PngWriter : public Object
+    {
+    public:
+        PngWriter(const std::string &file, size_t w, size_t h, size_t flush_size = 1 << 18);
+        PngWriter(const PngWriter&) = delete;
+        virtual ~PngWriter();
+
+        size_t width() const;
+        size_t height() const;
+        size_t rows_written() const;
+        //conversion of Vector3d rows to 8 bit, rounding without tonemapping by default.
+        void quantizer(const Quantizer &q);
+
+        void write_row(const Vector3d *pixels);
+        void write_row(const unsigned char *rgb); //already quantized
+        void store(size_t x, size_t y, const Vector3d *pixels, size_t count);
+        //appends rows filtered and deflated elsewhere (see png_filter_row, png_deflate),
+        //adler is the adler32 of the length filtered bytes.
+        void write_deflated(const std::vector<unsigned char> &deflated, uint32_t adler, size_t length, size_t rows);
+        void finish();
+
+        virtual std::string to_string() const;
+
+    protected:
+        struct PendingRow
+        {
+            std::vector<unsigned char> rgb;
+            size_t filled;
+        };
+
+        std::string m_file;
+        std::ofstream m_out;
+        size_t m_width, m_height;
+        size_t m_flush_size;
+        size_t m_rows;
+        bool m_finished;
+        bool m_zlib_header; //written with the first IDAT
+        Quantizer m_quantizer;
+
+        std::vector<unsigned char> m_previous; //unfiltered previous row
+        std::vector<unsigned char> m_filtered; //waiting to be deflated
+        uint32_t m_adler;
+
+        //rows passed to store, guarded by m_lock. Complete rows move to m_ready in order and are
+        //written by the thread that set m_writing.
+        std::mutex m_lock;
+        std::map<size_t, PendingRow> m_pending;
+        std::deque<std::vector<unsigned char>> m_ready;
+        size_t m_completed_rows;
+        bool m_writing;
+
+        void filter_row(const unsigned char *rgb);
+        void deflate_filtered();
+        void write_chunk(const char *type, const unsigned char *data, size_t size);
+    };
+
+    //encodes image using thread_count threads for quantizing, filtering and compression.
+    void write_png(const Image &image, const std::string &file, size_t thread_count, const Quantizer &quantizer = Quantizer());
+
+    //appends the filter type and filtered row of n bytes to out, up is the row above (zeros for the first).
+    void png_filter_row(const unsigned char *rgb, const unsigned char *up, size_t n, std::vector<unsigned char> &out);
+    //deflates filtered rows into non-final blocks ending on a byte boundary.
+    std::vector<unsigned char> png_deflate(const std::vector<unsigned char> &filtered);
+    uint32_t adler32(uint32_t adler, const unsigned char *data, size_t size);
+    uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t length2);
+
+}
+
+#endif
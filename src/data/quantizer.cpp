@@ -0,0 +1,124 @@
+#include "quantizer.hpp"
+
+#include <cmath>
+
+namespace data
+{
+
+    static const size_t srgb_table_size = 4096;
+
+    //srgb encoded values of linear values i / srgb_table_size, interpolated between entries.
+    static const std::vector<float>& srgb_table()
+    {
+        static const std::vector<float> table = []()
+        {
+            std::vector<float> rval(srgb_table_size + 2);
+            for(size_t i = 0; i < rval.size(); ++i)
+            {
+                double l = std::min(1.0, double(i) / srgb_table_size);
+                rval[i] = l <= 0.0031308 ? 12.92 * l : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+            }
+            return rval;
+        }();
+        return table;
+    }
+
+    //8x8 bayer matrix
+    static const unsigned char bayer[8][8] =
+    {
+        {  0, 32,  8, 40,  2, 34, 10, 42 },
+        { 48, 16, 56, 24, 50, 18, 58, 26 },
+        { 12, 44,  4, 36, 14, 46,  6, 38 },
+        { 60, 28, 52, 20, 62, 30, 54, 22 },
+        {  3, 35, 11, 43,  1, 33,  9, 41 },
+        { 51, 19, 59, 27, 49, 17, 57, 25 },
+        { 15, 47,  7, 39, 13, 45,  5, 37 },
+        { 63, 31, 55, 23, 61, 29, 53, 21 }
+    };
+
+    Quantizer::Quantizer()
+        : m_exposure(1.0f), m_tonemap(Tonemap::NONE), m_srgb(false), m_dither(Dither::NONE) { }
+
+    double Quantizer::exposure() const { return m_exposure; }
+    void Quantizer::exposure(double e) { m_exposure = e; }
+    Quantizer::Tonemap Quantizer::tonemap() const { return m_tonemap; }
+    void Quantizer::tonemap(Tonemap t) { m_tonemap = t; }
+    bool Quantizer::srgb() const { return m_srgb; }
+    void Quantizer::enable_srgb() { m_srgb = true; }
+    void Quantizer::disable_srgb() { m_srgb = false; }
+    Quantizer::Dither Quantizer::dither() const { return m_dither; }
+    void Quantizer::dither(Dither d) { m_dither = d; }
+
+    void Quantizer::quantize(const Vector3d *pixels, size_t count, size_t x, size_t y, unsigned char *rgb) const
+    {
+        static thread_local std::vector<float> values;
+        values.resize(count * 3);
+
+        float *v = values.data();
+        for(size_t i = 0; i < count; ++i, v += 3)
+        {
+            v[0] = pixels[i].m_x;
+            v[1] = pixels[i].m_y;
+            v[2] = pixels[i].m_z;
+        }
+        quantize(values.data(), count, x, y, rgb);
+    }
+
+    void Quantizer::quantize(const float *pixels, size_t count, size_t x, size_t y, unsigned char *rgb) const
+    {
+        static thread_local std::vector<float> values, thresholds;
+        const size_t n = count * 3;
+        values.resize(n);
+        thresholds.resize(n);
+        float *v = values.data();
+        float *t = thresholds.data();
+
+        const float exposure = m_exposure;
+        if(m_tonemap == Tonemap::REINHARD)
+        {
+            for(size_t i = 0; i < n; ++i)
+            {
+                float e = std::max(0.0f, pixels[i] * exposure);
+                v[i] = e / (1.0f + e);
+            }
+        }
+        else for(size_t i = 0; i < n; ++i) v[i] = pixels[i] * exposure;
+
+        if(m_srgb)
+        {
+            const float *table = srgb_table().data();
+            for(size_t i = 0; i < n; ++i)
+            {
+                float f = std::min(std::max(v[i], 0.0f), 1.0f) * srgb_table_size;
+                size_t index = size_t(f);
+                float frac = f - index;
+                v[i] = table[index] + (table[index + 1] - table[index]) * frac;
+            }
+        }
+
+        //rounding is a constant threshold of one half
+        if(m_dither == Dither::ORDERED)
+        {
+            for(size_t i = 0; i < count; ++i)
+                t[i * 3] = t[i * 3 + 1] = t[i * 3 + 2] = (bayer[y & 7][(x + i) & 7] + 0.5f) / 64.0f;
+        }
+        else for(size_t i = 0; i < n; ++i) t[i] = 0.5f;
+
+        for(size_t i = 0; i < n; ++i)
+        {
+            float q = v[i] * 255.0f + t[i];
+            q = q < 0.0f ? 0.0f : (q > 255.0f ? 255.0f : q);
+            rgb[i] = (unsigned char)q;
+        }
+    }
+
+    std::string Quantizer::to_string() const
+    {
+        std::string s = "data::Quantizer - exposure " + std::to_string(m_exposure);
+        s += m_tonemap == Tonemap::REINHARD ? ", reinhard" : "";
+        s += m_srgb ? ", srgb" : "";
+        s += m_dither == Dither::ORDERED ? ", ordered dither" : "";
+        return s;
+    }
+
+}
@@ -0,0 +1,51 @@
+#ifndef DATA_QUANTIZER_HPP
+#define DATA_QUANTIZER_HPP
+
+#include <vector>
+#include "../core.hpp"
+
+namespace data
+{
+
+    /*
+        Converts rows of colors to 8 bit rgb for the encoders: exposure and an optional tonemap,
+        optionally the srgb transfer curve (for linear colors, the renderer's colors are already
+        display values so it is off by default), then rounding or ordered dithering and clamping.
+        Every stage is a separate pass over a float buffer of the row so the compiler can vectorize
+        them, the buffers are kept per thread. One quantizer can be used by several threads.
+    */
+
+    class Quantizer : public Object
+    {
+    public:
+        enum class Tonemap { NONE, REINHARD };
+        enum class Dither { NONE, ORDERED };
+
+        Quantizer();
+
+        double exposure() const;
+        void exposure(double e); //scale applied before tonemapping
+        Tonemap tonemap() const;
+        void tonemap(Tonemap t);
+        bool srgb() const;
+        void enable_srgb();
+        void disable_srgb();
+        Dither dither() const;
+        void dither(Dither d);
+
+        //count pixels of row y starting at x (the position selects the dither pattern) into rgb.
+        void quantize(const Vector3d *pixels, size_t count, size_t x, size_t y, unsigned char *rgb) const;
+        void quantize(const float *pixels, size_t count, size_t x, size_t y, unsigned char *rgb) const;
+
+        virtual std::string to_string() const;
+
+    protected:
+        float m_exposure;
+        Tonemap m_tonemap;
+        bool m_srgb;
+        Dither m_dither;
+    };
+
+}
+
+#endif
@@ -1345,8 +1345,9 @@ glmReadOBJ(const char* filename)
   /* allocate memory */
   model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
 				     3 * (model->numvertices + 1));
-  model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
-					  model->numtriangles);
+  /* zeroed: faces without texcoords/normals leave their indices at 0 */
+  model->triangles = (GLMtriangle*)calloc(model->numtriangles,
+					  sizeof(GLMtriangle));
   if (model->numnormals) {
     model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
 				      3 * (model->numnormals + 1));
@@ -787,6 +787,16 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Like lodepng_deflate, but all blocks are non-final and the output ends with an empty stored
+block (a zlib sync flush) on a byte boundary, so the output of several calls can be concatenated
+into one stream. Terminate that stream with a final (empty) block. Matches on data of earlier
+calls are not used.
+*/
+unsigned lodepng_deflate_flush(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t insize,
+                               const LodePNGCompressSettings* settings);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
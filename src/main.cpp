@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
+#include <unistd.h>
 
 using namespace std;
 
@@ -20,46 +21,67 @@ int main(int argc, char **argv)
     cam.set_image(800, 800, 2);
 
     Scene *scene = new Scene();
-    scene->add_light(new PointLight(Vector3d(1.0), Vector3d(-200, 600, 1500)));
-    Material *blue = new Material(Vector3d(0.0, 0.0, 0.14), Vector3d(0.0, 0.0, 0.7), Vector3d(0.5), 64);
-    Material *green = new Material(Vector3d(0.0, 0.06, 0.0), Vector3d(0.0, 0.3, 0.0), Vector3d(0.5), 8);
-    Material *red = new Material(Vector3d(0.14, 0.0, 0.0), Vector3d(0.7, 0.0, 0.0), Vector3d(0.5), 32);
-    Material *yellow = new Material(Vector3d(0.16, 0.128, 0.0), Vector3d(0.8, 0.64, 0.0), Vector3d(0.0), 1);
-    Material *orange = new Material(Vector3d(0.16, 0.08, 0.0), Vector3d(0.8, 0.4, 0.0), Vector3d(0.5), 32);
-    Material *gray = new Material(Vector3d(0.08), Vector3d(0.32), Vector3d(0.75), 256);
+    scene->create<PointLight>(Vector3d(1.0), Vector3d(-200, 600, 1500));
+    Material *blue = scene->create<Material>(Vector3d(0.0, 0.0, 0.14), Vector3d(0.0, 0.0, 0.7), Vector3d(0.5), 64);
+    Material *green = scene->create<Material>(Vector3d(0.0, 0.06, 0.0), Vector3d(0.0, 0.3, 0.0), Vector3d(0.5), 8);
+    Material *red = scene->create<Material>(Vector3d(0.14, 0.0, 0.0), Vector3d(0.7, 0.0, 0.0), Vector3d(0.5), 32);
+    Material *yellow = scene->create<Material>(Vector3d(0.16, 0.128, 0.0), Vector3d(0.8, 0.64, 0.0), Vector3d(0.0), 1);
+    Material *orange = scene->create<Material>(Vector3d(0.16, 0.08, 0.0), Vector3d(0.8, 0.4, 0.0), Vector3d(0.5), 32);
+    Material *gray = scene->create<Material>(Vector3d(0.08), Vector3d(0.32), Vector3d(0.75), 256);
 
-    Sphere *sp = new Sphere(Vector3d(90, 320, 100), 50);
-    sp->material(blue);
-    scene->add_shape(sp);
+    scene->create<Sphere>(Vector3d(90, 320, 100), 50)->material(blue);
+    scene->create<Sphere>(Vector3d(210, 270, 300), 50)->material(green);
+    scene->create<Sphere>(Vector3d(290, 170, 150), 50)->material(red);
+    scene->create<Sphere>(Vector3d(110, 130, 200), 50)->material(orange);
+    scene->create<Sphere>(Vector3d(200, 200, -1000), 1000)->material(gray);
 
-    sp = new Sphere(Vector3d(210, 270, 300), 50);
-    sp->material(green);
-    scene->add_shape(sp);
-
-    sp = new Sphere(Vector3d(290, 170, 150), 50);
-    sp->material(red);
-    scene->add_shape(sp);
-    
-    sp = new Sphere(Vector3d(110, 130, 200), 50);
-    sp->material(orange);
-    scene->add_shape(sp);
-
-    sp = new Sphere(Vector3d(200, 200, -1000), 1000);
-    sp->material(gray);
-    scene->add_shape(sp);
-
-    Mesh *m = new Mesh("models/devilduk.obj", yellow, Vector3d(140, 220, 400), 150);
-    scene->add_shape(m);
+    scene->create<Mesh>("models/devilduk.obj", yellow, Vector3d(140, 220, 400), 150);
 
     PhongShadingModel rm;
     rm.camera(cam);
     rm.scene(scene);
     rm.enable_shadows();
     rm.reflection_depth(4);
+    rm.tile_callback(console_progress());
 
     std::cout << *scene << endl;
-    data::Image *img = rm.render_threaded(8);
-    img->write_to_file("image.png");
+
+    /*
+        eztrace                         renders on 8 threads
+        eztrace -p <n>                  renders on n local worker processes
+        eztrace -s <port> [threads]     serves frames as a worker for remote coordinators, on 8 threads by default
+        eztrace -c <host:port> ...      coordinates workers started with -s
+    */
+    std::string mode = argc > 1 ? argv[1] : "";
+    if(mode == "-s" && argc > 2)
+    {
+        int listener = listen_tcp(std::stoi(argv[2]));
+        size_t thread_count = argc > 3 ? std::stoul(argv[3]) : 8;
+        while(true)
+        {
+            int connection = accept_tcp(listener);
+            try { rm.serve(connection, thread_count); }
+            catch(const Exception &ex) { std::cerr << ex.what() << endl; }
+            close(connection);
+        }
+    }
+
+    data::Image *img;
+    if(mode == "-p" && argc > 2) img = rm.render_distributed(std::stoul(argv[2]));
+    else if(mode == "-c" && argc > 2)
+    {
+        std::vector<int> connections;
+        for(int i = 2; i < argc; ++i)
+        {
+            std::vector<std::string> address = split(argv[i], ':');
+            connections.push_back(connect_tcp(address[0], std::stoi(address.back())));
+        }
+        img = rm.render_distributed(connections);
+        for(int fd : connections) close(fd);
+    }
+    else img = rm.render_threaded(8);
+
+    img->write_to_file("image.png", 8);
     
     delete img;
     delete scene;
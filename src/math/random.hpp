@@ -0,0 +1,52 @@
+#ifndef EZ_MATH_RANDOM_HPP
+#define EZ_MATH_RANDOM_HPP
+/*
+    Counter based random numbers.
+    Every value is a pure function of its counters (pixel, sample index, frame and dimension),
+    so results do not depend on which thread evaluates a pixel or in which order work is handed out.
+*/
+
+#include <cstdint>
+
+namespace math
+{
+
+    //pcg hash (Jarzynski & Olano, "Hash Functions for GPU Rendering")
+    inline uint32_t pcg_hash(uint32_t v)
+    {
+        uint32_t state = v * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    //mixes v into hash h
+    inline uint32_t hash_combine(uint32_t h, uint32_t v)
+    {
+        return pcg_hash(h ^ (pcg_hash(v) + 0x9e3779b9u + (h << 6) + (h >> 2)));
+    }
+
+    class PixelRandom
+    {
+    public:
+        PixelRandom(uint32_t x, uint32_t y, uint32_t frame, uint32_t seed = 0)
+            : m_key(hash_combine(hash_combine(hash_combine(pcg_hash(seed), frame), y), x)) { }
+
+        //random bits for the given sample and dimension of this pixel
+        uint32_t bits(uint32_t sample, uint32_t dimension) const
+        {
+            return hash_combine(hash_combine(m_key, sample), dimension);
+        }
+
+        //uniform number in [0, 1)
+        double uniform(uint32_t sample, uint32_t dimension) const
+        {
+            return (bits(sample, dimension) >> 8) * (1.0 / 16777216.0);
+        }
+
+    protected:
+        uint32_t m_key;
+    };
+
+}
+
+#endif
@@ -106,7 +106,7 @@ namespace math
 
         Vector3<T> reflect_over(const Vector3<T> &normal) const
         {
-            Vector3<T> ret = (*this - 2 * (*this).dot(normal) * normal);
+            Vector3<T> ret = (*this - normal * (2 * (*this).dot(normal)));
             return ret.normalized();
         }
 
@@ -0,0 +1,72 @@
+#include "arena.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+#include "rendering/threading.hpp"
+
+namespace raytracer
+{
+
+    Arena::Arena(size_t block_size)
+        : m_block_size(block_size), m_used(0), m_size(0) { }
+
+    Arena::~Arena()
+    {
+        clear();
+        for(Block &block : m_blocks) free(block.data);
+    }
+
+    void* Arena::allocate(size_t size, size_t alignment)
+    {
+        if(!m_blocks.empty())
+        {
+            size_t start = (m_used + alignment - 1) & ~(alignment - 1);
+            if(start + size <= m_blocks.back().size)
+            {
+                m_used = start + size;
+                m_size += size;
+                return m_blocks.back().data + start;
+            }
+        }
+
+        //new block, objects larger than a block get one of their own. blocks start on a cache line.
+        Block block;
+        block.size = std::max(m_block_size, size);
+        void *p = nullptr;
+        if(posix_memalign(&p, std::max(alignment, cache_line_size), block.size) != 0) throw std::bad_alloc();
+        block.data = static_cast<char*>(p);
+        m_blocks.push_back(block);
+
+        m_used = size;
+        m_size += size;
+        return block.data;
+    }
+
+    void Arena::clear()
+    {
+        for(auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it)
+            it->destroy(it->object);
+        m_destructors.clear();
+
+        for(size_t i = 1; i < m_blocks.size(); ++i) free(m_blocks[i].data);
+        if(!m_blocks.empty()) m_blocks.resize(1);
+        m_used = 0;
+        m_size = 0;
+    }
+
+    size_t Arena::size() const { return m_size; }
+
+    size_t Arena::capacity() const
+    {
+        size_t capacity = 0;
+        for(const Block &block : m_blocks) capacity += block.size;
+        return capacity;
+    }
+
+    std::string Arena::to_string() const
+    {
+        return "raytracer::Arena " + std::to_string(size()) + " of " + std::to_string(capacity()) + " bytes, " +
+            std::to_string(m_blocks.size()) + " blocks\n";
+    }
+
+}
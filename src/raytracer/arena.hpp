@@ -0,0 +1,69 @@
+#ifndef RAYTRACER_ARENA_HPP
+#define RAYTRACER_ARENA_HPP
+
+#include <new>
+#include <vector>
+#include <utility>
+#include <type_traits>
+#include "../core.hpp"
+
+namespace raytracer
+{
+
+    /*
+        Bump allocator for scene objects. Objects are placed back to back in large blocks (in the
+        order they are created, so objects created together are traversed together) and are only
+        destroyed all at once by clear or the destructor, in reverse order of creation.
+        clear keeps the first block, so refilling an arena for the next frame does not allocate.
+        Not thread-safe.
+    */
+
+    class Arena : public Object
+    {
+    public:
+        Arena(size_t block_size = 1 << 16);
+        Arena(const Arena&) = delete;
+        virtual ~Arena();
+
+        template<typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            T *object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if(!std::is_trivially_destructible<T>::value)
+                m_destructors.push_back(Destructor{ object, &destroy<T> });
+            return object;
+        }
+
+        void* allocate(size_t size, size_t alignment);
+        void clear(); //destroys every object
+
+        size_t size() const; //bytes handed out
+        size_t capacity() const; //bytes allocated in blocks
+
+        virtual std::string to_string() const;
+
+    protected:
+        struct Block
+        {
+            char *data;
+            size_t size;
+        };
+
+        struct Destructor
+        {
+            void *object;
+            void (*destroy)(void*);
+        };
+
+        std::vector<Block> m_blocks;
+        std::vector<Destructor> m_destructors;
+        size_t m_block_size;
+        size_t m_used; //of the last block
+        size_t m_size;
+
+        template<typename T> static void destroy(void *object) { static_cast<T*>(object)->~T(); }
+    };
+
+}
+
+#endif
@@ -1,16 +1,38 @@
 #include "material.hpp"
 
 #include <fstream>
+#include <iostream>
 
 namespace raytracer
 {
 
+    static Texture* load_map(const std::string &file, TextureCache &cache)
+    {
+        if(file.empty()) return nullptr;
+
+        //a missing map should not keep the scene from loading.
+        try { return cache.load(file); }
+        catch(const Exception &ex)
+        {
+            std::cerr << "warning, texture map left out: " << ex.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    Material::Material(const ObjMaterial &mat, TextureCache &cache)
+        : m_ambient(mat.m_ambient), m_diffuse(mat.m_diffuse), m_specular(mat.m_specular), 
+          m_specular_exponent(mat.m_specular_exponent),
+          m_ambient_map(load_map(mat.m_ambient_texture, cache)),
+          m_diffuse_map(load_map(mat.m_diffuse_texture, cache)),
+          m_specular_map(load_map(mat.m_specular_texture, cache)) { }
+
     std::string Material::to_string() const
     {
         std::string s = "raytracer::Material\n";
         s += "    ambient: " + m_ambient.to_string() + "\n";
         s += "    diffuse: " + m_diffuse.to_string() + "\n";
         s += "    specular: " + m_specular.to_string() + " - " + std::to_string(m_specular_exponent) + "\n";
+        if(m_diffuse_map) s += "    diffuse map: " + m_diffuse_map->to_string();
         return s;
     }
 
@@ -23,6 +45,11 @@ namespace raytracer
         ObjMaterial mat;
         std::vector<ObjMaterial> materials;
 
+        //map filenames are relative to the mtl file, options (-bm etc.) before the filename are skipped
+        size_t slash = file.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+        auto map_file = [&directory](const std::string &name) { return name[0] == '/' ? name : directory + name; };
+
         while(!in.eof())
         {
             std::string buffer = get_line(in);
@@ -52,17 +79,18 @@ namespace raytracer
             
             //texture maps
             else if(parts[0] == "map_Ka")
-                mat.m_ambient_texture = parts[1];
+                mat.m_ambient_texture = map_file(parts.back());
             else if(parts[0] == "map_Kd")
-                mat.m_diffuse_texture = parts[1];
+                mat.m_diffuse_texture = map_file(parts.back());
             else if(parts[0] == "map_Ks")
-                mat.m_specular_texture = parts[1];
+                mat.m_specular_texture = map_file(parts.back());
             else if(parts[0] == "bump" || parts[0] == "map_bump")
-                mat.m_bump_map = parts[1];
+                mat.m_bump_map = map_file(parts.back());
             else if(parts[0] == "disp")
-                mat.m_displacement_map = parts[1];
+                mat.m_displacement_map = map_file(parts.back());
         }
 
+        if(mat.m_name != "") materials.push_back(mat);
         return materials;
     }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "../core.hpp"
+#include "texture.hpp"
 
 namespace raytracer
 {
@@ -26,7 +27,7 @@ namespace raytracer
         Vector3d m_specular;
         double m_specular_exponent;
 
-        //texture map filenames
+        //texture map filenames, relative to the working directory (parse_mtl_file resolves them)
         std::string m_bump_map;
         std::string m_displacement_map;
 
@@ -39,11 +40,12 @@ namespace raytracer
     {
     public:
         Material(Vector3d am, Vector3d diff, Vector3d spec, double exp) 
-            : m_ambient(am), m_diffuse(diff), m_specular(spec), m_specular_exponent(exp) { }
+            : m_ambient(am), m_diffuse(diff), m_specular(spec), m_specular_exponent(exp),
+              m_ambient_map(nullptr), m_diffuse_map(nullptr), m_specular_map(nullptr) { }
 
-        Material(const ObjMaterial &mat)
-            : m_ambient(mat.m_ambient), m_diffuse(mat.m_diffuse), m_specular(mat.m_specular), 
-              m_specular_exponent(mat.m_specular_exponent) { }
+        //texture maps are loaded through (and owned by) the cache, maps that fail to load are left out
+        //with a warning. Bump and displacement maps are not used for rendering and not loaded.
+        Material(const ObjMaterial &mat, TextureCache &cache = TextureCache::shared());
         virtual ~Material() { }
 
         virtual std::string to_string() const;
@@ -52,6 +54,11 @@ namespace raytracer
         const Vector3d m_diffuse;
         const Vector3d m_specular;
         const double m_specular_exponent;
+
+        //texture maps, nullptr when not set, the diffuse map is multiplied with m_diffuse.
+        Texture *m_ambient_map;
+        Texture *m_diffuse_map;
+        Texture *m_specular_map;
     };
 
     std::vector<ObjMaterial> parse_mtl_file(const std::string &file);
@@ -10,6 +10,53 @@ namespace raytracer
 
     Vector3d Ray::origin() const { return m_origin; }
     Vector3d Ray::direction() const { return m_direction; }
+    bool Ray::has_differentials() const { return m_differentials; }
+
+    //derivative of the normalized w, given the derivative of w.
+    static Vector3d normalized_differential(const Vector3d &w, const Vector3d &dw)
+    {
+        Vector3d d = w.normalized();
+        return (dw - d * d.dot(dw)) / w.length();
+    }
+
+    Ray Ray::through(const Vector3d &origin, const Vector3d &target, const Vector3d &target_dx, const Vector3d &target_dy)
+    {
+        Vector3d w = target - origin;
+        return Ray(origin, w.normalized(), Vector3d(0.0), Vector3d(0.0),
+            normalized_differential(w, target_dx), normalized_differential(w, target_dy));
+    }
+
+    void Ray::point_differentials(double distance, const Vector3d &normal, Vector3d &dx, Vector3d &dy) const
+    {
+        if(!m_differentials)
+        {
+            dx = dy = Vector3d(0.0);
+            return;
+        }
+
+        //the neighbouring rays travel to the plane through the hit point (Igehy, tracing ray differentials)
+        double dn = m_direction.dot(normal);
+        if(dn == 0) dn = 1e-12;
+        dx = m_origin_dx + m_direction_dx * distance;
+        dy = m_origin_dy + m_direction_dy * distance;
+        dx -= m_direction * (dx.dot(normal) / dn);
+        dy -= m_direction * (dy.dot(normal) / dn);
+    }
+
+    Ray Ray::reflect(double distance, const Vector3d &normal, const Vector3d &normal_dx, const Vector3d &normal_dy) const
+    {
+        Vector3d point = at(distance);
+        double dn = m_direction.dot(normal);
+        Vector3d r = m_direction - normal * (2 * dn);
+        if(!m_differentials) return Ray(point, r.normalized());
+
+        //derivative of d - 2 (d.n) n
+        Vector3d dx, dy;
+        point_differentials(distance, normal, dx, dy);
+        Vector3d rdx = m_direction_dx - (normal * (m_direction_dx.dot(normal) + m_direction.dot(normal_dx)) + normal_dx * dn) * 2;
+        Vector3d rdy = m_direction_dy - (normal * (m_direction_dy.dot(normal) + m_direction.dot(normal_dy)) + normal_dy * dn) * 2;
+        return Ray(point, r.normalized(), dx, dy, normalized_differential(r, rdx), normalized_differential(r, rdy));
+    }
 
     std::string Ray::to_string() const
     {
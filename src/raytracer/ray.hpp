@@ -7,11 +7,25 @@
 namespace raytracer
 {
 
+    /*
+        Ray with optional differentials: the change of origin and direction between this ray and
+        the rays of the neighbouring pixels (x and y), used to estimate the footprint of a pixel
+        on the surfaces it hits for texture filtering.
+    */
+
     class Ray : public Object
     {
     public:
         Ray(const Vector3d &origin, const Vector3d &direction)
-            : m_origin(origin), m_direction(direction) { };
+            : m_origin(origin), m_direction(direction), m_differentials(false) { };
+
+        Ray(const Vector3d &origin, const Vector3d &direction,
+            const Vector3d &origin_dx, const Vector3d &origin_dy, const Vector3d &direction_dx, const Vector3d &direction_dy)
+            : m_origin(origin), m_direction(direction), m_origin_dx(origin_dx), m_origin_dy(origin_dy),
+              m_direction_dx(direction_dx), m_direction_dy(direction_dy), m_differentials(true) { };
+
+        //ray from origin through target, target_dx/dy being the distance to the neighbouring pixels' targets.
+        static Ray through(const Vector3d &origin, const Vector3d &target, const Vector3d &target_dx, const Vector3d &target_dy);
 
         Vector3d at(double distance) const;
         virtual std::string to_string() const;
@@ -19,9 +33,22 @@ namespace raytracer
         Vector3d origin() const;
         Vector3d direction() const;
 
+        bool has_differentials() const;
+        //differentials of the hit point at distance on a surface with normal.
+        void point_differentials(double distance, const Vector3d &normal, Vector3d &dx, Vector3d &dy) const;
+        //mirror reflection at distance, with differentials if this ray has them, normal_dx/dy being the
+        //change of the normal over the footprint (0 for flat surfaces).
+        Ray reflect(double distance, const Vector3d &normal,
+            const Vector3d &normal_dx = Vector3d(0.0), const Vector3d &normal_dy = Vector3d(0.0)) const;
+
     protected:
         Vector3d m_origin;
         Vector3d m_direction;
+        Vector3d m_origin_dx;
+        Vector3d m_origin_dy;
+        Vector3d m_direction_dx;
+        Vector3d m_direction_dy;
+        bool m_differentials;
     };
 
 }
@@ -0,0 +1,112 @@
+#include "distributed.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace raytracer
+{
+
+    void write_all(int fd, const void *data, size_t size)
+    {
+        const char *bytes = (const char*)data;
+        while(size > 0)
+        {
+            //send so a worker dying does not take us down with SIGPIPE, plain write for pipes.
+            ssize_t written = send(fd, bytes, size, MSG_NOSIGNAL);
+            if(written < 0 && errno == ENOTSOCK) written = ::write(fd, bytes, size);
+            if(written < 0 && errno == EINTR) continue;
+            if(written <= 0) throw Exception(__PRETTY_FUNCTION__, "write failed - " + std::string(strerror(errno)));
+
+            bytes += written;
+            size -= written;
+        }
+    }
+
+    void read_all(int fd, void *data, size_t size)
+    {
+        char *bytes = (char*)data;
+        while(size > 0)
+        {
+            ssize_t received = ::read(fd, bytes, size);
+            if(received < 0 && errno == EINTR) continue;
+            if(received == 0) throw Exception(__PRETTY_FUNCTION__, "connection closed");
+            if(received < 0) throw Exception(__PRETTY_FUNCTION__, "read failed - " + std::string(strerror(errno)));
+
+            bytes += received;
+            size -= received;
+        }
+    }
+
+    int listen_tcp(uint16_t port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "socket failed - " + std::string(strerror(errno)));
+
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+
+        if(bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0)
+        {
+            std::string error = strerror(errno);
+            close(fd);
+            throw Exception(__PRETTY_FUNCTION__, "failed to listen on port " + std::to_string(port) + " - " + error);
+        }
+
+        return fd;
+    }
+
+    int accept_tcp(int listener)
+    {
+        int fd;
+        do fd = accept(listener, nullptr, nullptr);
+        while(fd < 0 && errno == EINTR);
+
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "accept failed - " + std::string(strerror(errno)));
+
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+    int connect_tcp(const std::string &host, uint16_t port)
+    {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo *result;
+        int error = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+        if(error != 0) throw Exception(__PRETTY_FUNCTION__, "cannot resolve " + host + " - " + gai_strerror(error));
+
+        int fd = -1;
+        for(addrinfo *ai = result; ai; ai = ai->ai_next)
+        {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if(fd < 0) continue;
+            if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(result);
+
+        if(fd < 0) throw Exception(__PRETTY_FUNCTION__, "cannot connect to " + host + ":" + std::to_string(port));
+
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+}
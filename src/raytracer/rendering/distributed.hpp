@@ -0,0 +1,51 @@
+#ifndef RAYTRACER_RENDERING_DISTRIBUTED_HPP
+#define RAYTRACER_RENDERING_DISTRIBUTED_HPP
+
+#include <cstdint>
+#include <string>
+#include "../../core.hpp"
+
+namespace raytracer
+{
+
+    /*
+        Coordinator/worker protocol used by RenderModel::render_distributed and RenderModel::serve.
+        Every connection is a bidirectional byte stream (a socketpair for local processes or a tcp
+        socket for remote machines), all values are sent in host byte order.
+
+        coordinator -> worker: FrameHeader, then Assignments, an assignment with 0 rows ends the frame.
+        worker -> coordinator: per assignment the Assignment echoed, followed by
+                               rows * width rgb triplets of doubles.
+
+        Workers render against their own scene and camera, the frame header only lets them verify
+        they were configured with the same image dimensions and frame number (which keys sampling).
+    */
+
+    const uint32_t distributed_magic = 0x657A7472; //"eztr"
+
+    struct FrameHeader
+    {
+        uint32_t magic;
+        uint32_t width;
+        uint32_t height;
+        uint32_t frame;
+    };
+
+    struct Assignment
+    {
+        uint32_t y;
+        uint32_t rows;
+    };
+
+    //blocking full reads/writes, throw on errors or a closed connection.
+    void write_all(int fd, const void *data, size_t size);
+    void read_all(int fd, void *data, size_t size);
+
+    //tcp helpers for running workers on other machines.
+    int listen_tcp(uint16_t port);
+    int accept_tcp(int listener);
+    int connect_tcp(const std::string &host, uint16_t port);
+
+}
+
+#endif
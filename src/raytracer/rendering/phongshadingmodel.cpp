@@ -46,7 +46,24 @@ namespace raytracer
         return image;
     }*/
 
-    Vector3d PhongShadingModel::trace(const Ray &ray, size_t reflections_left)
+    Vector3d PhongShadingModel::trace(const Ray &ray, size_t reflections_left) const
+    {
+        return m_shadows ? shade<true>(ray, reflections_left) : shade<false>(ray, reflections_left);
+    }
+
+    TraceFunction PhongShadingModel::tracer() const
+    {
+        return m_shadows ? &trace_static<true> : &trace_static<false>;
+    }
+
+    template<bool Shadows>
+    Vector3d PhongShadingModel::trace_static(const RenderModel &model, const Ray &ray, size_t reflections_left)
+    {
+        return static_cast<const PhongShadingModel&>(model).shade<Shadows>(ray, reflections_left);
+    }
+
+    template<bool Shadows>
+    Vector3d PhongShadingModel::shade(const Ray &ray, size_t reflections_left) const
     {
         Hit min_hit = m_scene->closest_hit(ray);
         if(min_hit.missed()) return m_background_color;
@@ -57,6 +74,15 @@ namespace raytracer
 
         color = min_hit.shape()->material()->m_ambient;
 
+        //filtered over the pixel footprint when the ray carries differentials
+        Vector3d diffuse, dx, dy;
+        if(ray.has_differentials())
+        {
+            ray.point_differentials(min_hit.distance(), min_hit.normal(), dx, dy);
+            diffuse = min_hit.shape()->color_at(hit, dx, dy);
+        }
+        else diffuse = min_hit.shape()->color_at(hit);
+
         //for all lights
         for(size_t i = 0; i < m_scene->lights().size(); ++i)
         {
@@ -64,9 +90,9 @@ namespace raytracer
             Vector3d R = (2.0 * L.dot(min_hit.normal()) * min_hit.normal() - L).normalized();
 
             //sharp shadows
-            if(m_shadows && m_scene->closest_hit(Ray(m_scene->lights()[i]->position(), -L)).shape() != min_hit.shape()) continue;
+            if(Shadows && m_scene->closest_hit(Ray(m_scene->lights()[i]->position(), -L)).shape() != min_hit.shape()) continue;
 
-            color += max(0.0, L.dot(min_hit.normal())) * min_hit.shape()->color_at(hit) * m_scene->lights()[i]->color();
+            color += max(0.0, L.dot(min_hit.normal())) * diffuse * m_scene->lights()[i]->color();
             color += pow(max(0.0, R.dot(-ray.direction())), min_hit.shape()->material()->m_specular_exponent) * min_hit.shape()->material()->m_specular * m_scene->lights()[i]->color();
         }
 
@@ -74,8 +100,10 @@ namespace raytracer
         {
             if(min_hit.shape()->material()->m_specular != black)
             {
-                Vector3d R = ray.direction().reflect_over(min_hit.normal());
-                color += trace(Ray(hit, R), reflections_left - 1) * min_hit.shape()->material()->m_specular;
+                const Shape *shape = min_hit.shape();
+                Ray reflection = ray.reflect(min_hit.distance(), min_hit.normal(),
+                    shape->normal_differential(hit, min_hit.normal(), dx), shape->normal_differential(hit, min_hit.normal(), dy));
+                color += shade<Shadows>(reflection, reflections_left - 1) * shape->material()->m_specular;
             }
         }
         color.clamp();
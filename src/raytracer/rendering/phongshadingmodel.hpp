@@ -13,9 +13,18 @@ namespace raytracer
         virtual ~PhongShadingModel();
 
         //irtual data::Image* render();
-        virtual Vector3d trace(const Ray &ray, size_t reflections_left);
+        virtual Vector3d trace(const Ray &ray, size_t reflections_left) const;
+        virtual TraceFunction tracer() const;
 
         virtual std::string to_string() const;
+
+    protected:
+        //trace with the shadow test compiled in or out, reflections recurse without virtual calls.
+        template<bool Shadows>
+        Vector3d shade(const Ray &ray, size_t reflections_left) const;
+
+        template<bool Shadows>
+        static Vector3d trace_static(const RenderModel &model, const Ray &ray, size_t reflections_left);
     };
 
 }
@@ -0,0 +1,500 @@
+#include "renderjob.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include "rendermodel.hpp"
+#include "tilescheduler.hpp"
+
+namespace raytracer
+{
+
+    RenderJob::RenderJob(const RenderModel &model, const Camera &camera)
+        : m_model(model), m_camera(camera), m_image(nullptr), m_owns_image(false), m_image_x(0), m_image_y(0),
+          m_framebuffer(nullptr), m_checkpoint_interval(0), m_writing_checkpoint(false)
+    {
+        if(!m_model.scene()) throw Exception(__PRETTY_FUNCTION__, "no scene set");
+
+        img_w = m_camera.image_width();
+        img_h = m_camera.image_height();
+
+        pixel_size = m_camera.up().length();
+        G = (m_camera.center() - m_camera.eye()).normalized();
+        A = (G.cross(m_camera.up())).normalized();
+        B = (A.cross(G)).normalized();
+
+        H = pixel_size * A;
+        V = pixel_size * B;
+        origin = m_camera.center()
+            - ((m_camera.image_width() / 2) * H)
+            - ((m_camera.image_height() / 2) * V);
+
+        offset_h = H / m_camera.supersamples();
+        offset_v = V / m_camera.supersamples();
+
+        m_region = Tile{ 0, 0, img_w, img_h };
+        select_kernel();
+    }
+
+    RenderJob::~RenderJob()
+    {
+        if(m_image && m_owns_image) delete m_image;
+    }
+
+    data::Image* RenderJob::render()
+    {
+        return render_threaded(1);
+    }
+
+    const Camera& RenderJob::camera() const { return m_camera; }
+    size_t RenderJob::width() const { return img_w; }
+    size_t RenderJob::height() const { return img_h; }
+    data::Image* RenderJob::image() { return m_image; }
+    const Tile& RenderJob::region() const { return m_region; }
+
+    void RenderJob::region(const Tile &rect)
+    {
+        if(rect.x >= img_w || rect.y >= img_h || rect.width == 0 || rect.height == 0)
+            throw Exception(__PRETTY_FUNCTION__, "region is empty or outside the frame");
+
+        m_region = rect;
+        m_region.width = std::min(rect.width, img_w - rect.x);
+        m_region.height = std::min(rect.height, img_h - rect.y);
+        m_completed.clear();
+    }
+
+    void RenderJob::target(data::Image *image)
+    {
+        if(image->width() != img_w || image->height() != img_h)
+            throw Exception(__PRETTY_FUNCTION__, "target image does not match the frame dimensions");
+
+        if(m_image && m_owns_image) delete m_image;
+        m_image = image;
+        m_owns_image = false;
+        m_image_x = 0;
+        m_image_y = 0;
+        m_framebuffer = nullptr;
+    }
+
+    void RenderJob::target(data::FrameBuffer *framebuffer)
+    {
+        if(framebuffer->width() != img_w || framebuffer->height() != img_h)
+            throw Exception(__PRETTY_FUNCTION__, "target framebuffer does not match the frame dimensions");
+
+        if(m_image && m_owns_image) delete m_image;
+        m_image = nullptr;
+        m_owns_image = false;
+        m_framebuffer = framebuffer;
+    }
+
+    data::Image* RenderJob::release_image()
+    {
+        data::Image *rval = m_image;
+        m_image = nullptr;
+        m_owns_image = false;
+        return rval;
+    }
+
+    std::string RenderJob::to_string() const
+    {
+        return "raytracer::RenderJob - dimensions [" + std::to_string(img_w) + "," + std::to_string(img_h) + "]";
+    }
+
+    void RenderJob::allocate_image()
+    {
+        if(m_image && m_owns_image) delete m_image;
+        m_image = m_model.allocate_image(m_region.width, m_region.height);
+        m_owns_image = true;
+        m_framebuffer = nullptr;
+        m_image_x = m_region.x;
+        m_image_y = m_region.y;
+    }
+
+    void RenderJob::prepare()
+    {
+        if(!m_image && !m_framebuffer) allocate_image();
+        prepare_tiles();
+        select_kernel(); //model settings may have changed since construction
+        m_last_checkpoint = std::chrono::steady_clock::now();
+    }
+
+    data::Image* RenderJob::render_threaded(size_t thread_count)
+    {
+        TileScheduler scheduler(m_model);
+        scheduler.add(this);
+        scheduler.run(thread_count);
+
+        if(!m_checkpoint_file.empty())
+        {
+            //finished renders dont need their checkpoint anymore, aborted ones save their progress.
+            if(!aborted()) std::remove(m_checkpoint_file.c_str());
+            else write_checkpoint(m_completed);
+        }
+
+        return release_image();
+    }
+
+    std::vector<Tile> RenderJob::tiles() const
+    {
+        std::vector<Tile> rval;
+        size_t size = std::max<size_t>(1, m_model.tile_size());
+
+        size_t x1 = m_region.x + m_region.width;
+        size_t y1 = m_region.y + m_region.height;
+
+        for(size_t y = m_region.y; y < y1; y += size)
+            for(size_t x = m_region.x; x < x1; x += size)
+                rval.push_back(Tile{ x, y, std::min(size, x1 - x), std::min(size, y1 - y) });
+
+        return rval;
+    }
+
+    void RenderJob::prepare_tiles()
+    {
+        size_t count = tiles().size();
+        if(m_completed.size() != count) m_completed.assign(count, 0);
+    }
+
+    bool RenderJob::tile_completed(size_t index) const
+    {
+        return index < m_completed.size() && m_completed[index];
+    }
+
+    void RenderJob::complete_tile(size_t index)
+    {
+        std::unique_lock<std::mutex> lock(m_completed_lock);
+        m_completed[index] = 1;
+
+        if(m_checkpoint_file.empty() || m_writing_checkpoint) return;
+        if(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_last_checkpoint).count() < m_checkpoint_interval) return;
+
+        //completed tiles are no longer written to, so they can be saved while the others render.
+        m_writing_checkpoint = true;
+        std::vector<char> completed = m_completed;
+        lock.unlock();
+
+        try { write_checkpoint(completed); }
+        catch(const Exception &ex) { std::cerr << ex.what() << std::endl; }
+
+        lock.lock();
+        m_last_checkpoint = std::chrono::steady_clock::now();
+        m_writing_checkpoint = false;
+    }
+
+    bool RenderJob::aborted() const
+    {
+        return std::find(m_completed.begin(), m_completed.end(), 0) != m_completed.end();
+    }
+
+    /*
+        Tiles are rendered into a buffer of the rendering thread first, the shared image is only
+        touched once per tile. Rows of the buffer start on a cache line, so threads never write to
+        lines another thread is also writing to (tile edges in the image often share a line).
+    */
+    TileEvent RenderJob::render_tile(const Tile &tile)
+    {
+        static thread_local std::vector<Vector3d, CacheAlignedAllocator<Vector3d>> pixels;
+
+        //row sizes are a multiple of the cache line: stride a multiple of lcm(line, pixel) / pixel pixels.
+        size_t a = cache_line_size, b = sizeof(Vector3d);
+        while(b) { size_t r = a % b; a = b; b = r; }
+        const size_t per_line = cache_line_size / a;
+        const size_t stride = (tile.width + per_line - 1) / per_line * per_line;
+        if(pixels.size() < stride * tile.height) pixels.resize(stride * tile.height);
+
+        for(size_t row = 0; row < tile.height; ++row)
+            render_span(tile.y + row, tile.x, tile.x + tile.width, &pixels[row * stride]);
+
+        for(size_t row = 0; row < tile.height; ++row)
+        {
+            const Vector3d *in = &pixels[row * stride];
+            if(m_framebuffer) m_framebuffer->store(tile.x, tile.y + row, in, tile.width);
+            else m_image->store(tile.x - m_image_x, tile.y + row - m_image_y, in, tile.width);
+        }
+        if(m_framebuffer) m_framebuffer->flush(tile.x, tile.y, tile.width, tile.height);
+
+        return TileEvent{ this, tile, pixels.data(), stride, 0, 0 };
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    // Checkpoints
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    /*
+        Checkpoint file layout (host byte order):
+            CheckpointHeader
+            tile_count bytes, 1 for completed tiles
+            3 doubles per region pixel, the pixel color
+    */
+
+    static const uint32_t checkpoint_magic = 0x657A6370; //"ezcp"
+    static const uint32_t checkpoint_version = 2;
+
+    struct CheckpointHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t fingerprint;
+        uint32_t width, height;
+        uint32_t region_x, region_y, region_width, region_height;
+        uint32_t tile_size;
+        uint32_t tile_count;
+    };
+
+    void RenderJob::checkpoint(const std::string &file, double interval)
+    {
+        m_checkpoint_file = file;
+        m_checkpoint_interval = interval;
+    }
+
+    void RenderJob::resume(const std::string &file)
+    {
+        if(m_framebuffer) throw Exception(__PRETTY_FUNCTION__, "checkpoints need an image target");
+
+        std::ifstream in(file, std::ios::binary);
+        if(in.fail()) throw Exception(__PRETTY_FUNCTION__, "failed to open checkpoint " + file);
+
+        std::vector<Tile> all = tiles();
+        CheckpointHeader header;
+        in.read((char*)&header, sizeof(header));
+
+        if(!in || header.magic != checkpoint_magic || header.version != checkpoint_version)
+            throw Exception(__PRETTY_FUNCTION__, file + " is not a checkpoint");
+        if(header.fingerprint != fingerprint() || header.width != img_w || header.height != img_h
+            || header.region_x != m_region.x || header.region_y != m_region.y
+            || header.region_width != m_region.width || header.region_height != m_region.height
+            || header.tile_size != m_model.tile_size() || header.tile_count != all.size())
+            throw Exception(__PRETTY_FUNCTION__, file + " was written for a different render");
+
+        size_t pixels = m_region.width * m_region.height;
+        std::vector<char> completed(all.size());
+        std::vector<double> colors(pixels * 3);
+        in.read(completed.data(), completed.size());
+        in.read((char*)colors.data(), colors.size() * sizeof(double));
+        if(!in) throw Exception(__PRETTY_FUNCTION__, file + " is truncated");
+
+        if(!m_image) allocate_image();
+        for(size_t i = 0; i < all.size(); ++i)
+        {
+            if(!completed[i]) continue;
+
+            const Tile &tile = all[i];
+            for(size_t y = tile.y; y < tile.y + tile.height; ++y)
+                for(size_t x = tile.x; x < tile.x + tile.width; ++x)
+                {
+                    const double *color = &colors[((y - m_region.y) * m_region.width + (x - m_region.x)) * 3];
+                    m_image->set_pixel(Vector3d(color[0], color[1], color[2]), x - m_image_x, y - m_image_y);
+                }
+        }
+
+        m_completed = completed;
+    }
+
+    void RenderJob::write_checkpoint(const std::vector<char> &completed)
+    {
+        if(!m_image) throw Exception(__PRETTY_FUNCTION__, "checkpoints need an image target");
+
+        std::vector<Tile> all = tiles();
+        size_t pixels = m_region.width * m_region.height;
+        std::vector<double> colors(pixels * 3, 0.0);
+
+        for(size_t i = 0; i < all.size(); ++i)
+        {
+            if(!completed[i]) continue;
+
+            const Tile &tile = all[i];
+            for(size_t y = tile.y; y < tile.y + tile.height; ++y)
+                for(size_t x = tile.x; x < tile.x + tile.width; ++x)
+                {
+                    size_t index = (y - m_region.y) * m_region.width + (x - m_region.x);
+                    Vector3d color = m_image->get_pixel(x - m_image_x, y - m_image_y);
+                    colors[index * 3 + 0] = color.m_x;
+                    colors[index * 3 + 1] = color.m_y;
+                    colors[index * 3 + 2] = color.m_z;
+                }
+        }
+
+        CheckpointHeader header = { checkpoint_magic, checkpoint_version, fingerprint(),
+            uint32_t(img_w), uint32_t(img_h),
+            uint32_t(m_region.x), uint32_t(m_region.y), uint32_t(m_region.width), uint32_t(m_region.height),
+            uint32_t(m_model.tile_size()), uint32_t(all.size()) };
+
+        //write next to the old checkpoint and swap, so a crash while writing never loses it.
+        std::string temporary = m_checkpoint_file + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write((const char*)&header, sizeof(header));
+        out.write(completed.data(), completed.size());
+        out.write((const char*)colors.data(), colors.size() * sizeof(double));
+        out.close();
+
+        if(!out || std::rename(temporary.c_str(), m_checkpoint_file.c_str()) != 0)
+            throw Exception(__PRETTY_FUNCTION__, "failed to write checkpoint " + m_checkpoint_file);
+    }
+
+    //hash of everything that influences the pixels, guards against resuming a different render.
+    uint32_t RenderJob::fingerprint() const
+    {
+        uint32_t h = checkpoint_version;
+        auto mix = [&h](double d)
+        {
+            uint64_t bits;
+            memcpy(&bits, &d, sizeof(bits));
+            h = math::hash_combine(h, uint32_t(bits));
+            h = math::hash_combine(h, uint32_t(bits >> 32));
+        };
+
+        for(const Vector3d &v : { m_camera.eye(), m_camera.center(), m_camera.up() })
+        {
+            mix(v.m_x); mix(v.m_y); mix(v.m_z);
+        }
+        mix(img_w); mix(img_h);
+        mix(m_camera.supersamples());
+        mix(m_camera.depth_of_field());
+        mix(m_camera.aperture_radius());
+        mix(m_camera.aperture_samples());
+
+        mix(m_model.shadows());
+        mix(m_model.reflection_depth());
+        mix(m_model.adaptive_dof());
+        mix(m_model.jitter());
+        mix(m_model.frame());
+        mix(m_model.scene()->shapes().size());
+        mix(m_model.scene()->lights().size());
+        return h;
+    }
+
+    void RenderJob::render_line(int y, Vector3d *row)
+    {
+        render_span(y, 0, img_w, row);
+    }
+
+    void RenderJob::render_span(int y, size_t x0, size_t x1, Vector3d *out)
+    {
+        (this->*m_kernel)(y, x0, x1, out);
+    }
+
+    void RenderJob::select_kernel()
+    {
+        m_tracer = m_model.tracer();
+
+        bool dof = m_camera.depth_of_field();
+        switch(m_camera.supersamples())
+        {
+            case 0: m_kernel = &RenderJob::render_simple_threaded; break;
+            case 1: m_kernel = dof ? &RenderJob::render_supersampled_threaded<1, true> : &RenderJob::render_supersampled_threaded<1, false>; break;
+            case 2: m_kernel = dof ? &RenderJob::render_supersampled_threaded<2, true> : &RenderJob::render_supersampled_threaded<2, false>; break;
+            case 3: m_kernel = dof ? &RenderJob::render_supersampled_threaded<3, true> : &RenderJob::render_supersampled_threaded<3, false>; break;
+            case 4: m_kernel = dof ? &RenderJob::render_supersampled_threaded<4, true> : &RenderJob::render_supersampled_threaded<4, false>; break;
+            default: m_kernel = dof ? &RenderJob::render_supersampled_threaded<0, true> : &RenderJob::render_supersampled_threaded<0, false>; break;
+        }
+    }
+
+    void RenderJob::render_simple_threaded(int y, size_t x0, size_t x1, Vector3d *out)
+    {
+        for(size_t x = x0; x < x1; ++x)
+        {
+            Vector3d pixel(x + 0.5, img_h - 1 - y - 0.6, 0);
+            Ray ray = Ray::through(m_camera.eye(), pixel, Vector3d(1, 0, 0), Vector3d(0, 1, 0));
+            Vector3d color = m_tracer(m_model, ray, 0);
+
+            out[x - x0] = color;
+        }
+    }
+
+    template<size_t Supersamples, bool DepthOfField>
+    void RenderJob::render_supersampled_threaded(int y, size_t x0, size_t x1, Vector3d *out)
+    {
+        const size_t ss = Supersamples ? Supersamples : m_camera.supersamples();
+        const size_t reflections = m_model.reflection_depth();
+        const Vector3d eye = m_camera.eye();
+
+        for(size_t x = x0; x < x1; ++x)
+        {
+            Vector3d average(0.0);
+            Vector3d pixel = origin + x * H + (img_h - pixel_size - y) * V;
+            math::PixelRandom random(x, y, m_model.frame());
+
+            size_t samples = 1;
+            double c = 0, rotation = 0;
+            if(DepthOfField)
+            {
+                samples = m_camera.aperture_samples();
+                if(m_model.adaptive_dof()) samples = adaptive_aperture_samples(pixel + (H / 2) + (V / 2));
+
+                c = m_camera.aperture_radius() / (m_camera.up().length() * sqrt(samples));
+
+                //jittering rotates the aperture spiral per pixel, trading banding for noise.
+                rotation = m_model.jitter() ? random.uniform(0, 2) * 2.0 * math::pi : 0.0;
+            }
+
+            //loop through dof angles
+            for(size_t dof = 0; dof < samples; ++dof)
+            {
+                Vector3d dofeye = eye;
+                if(DepthOfField)
+                {
+                    double r = c * sqrt(dof);
+                    //last part = golden angle
+                    double theta = rotation + dof * (180.0 * (3.0 - sqrt(5.0)));
+
+                    dofeye += (r * A * cos(theta)); //y displacement
+                    dofeye += (r * m_camera.up() * sin(theta)); //x displacement
+                }
+
+                //supersample dof angles
+                for(size_t i = 0; i < ss; ++i)
+                {
+                    for(size_t j = 0; j < ss; ++j)
+                    {
+                        Vector3d des = pixel + (i * offset_h) + (j * offset_v);
+                        des = des + jitter(random, (dof * ss + i) * ss + j);
+                        Ray ray = Ray::through(dofeye, des, offset_h, offset_v); //footprint of one supersample
+                        average += m_tracer(m_model, ray, reflections);
+                    }
+                }
+            }
+            average /= (ss * ss) * samples;
+            out[x - x0] = average;
+        }
+    }
+
+    //offset of a supersample within its subpixel, the center unless jittering is enabled.
+    Vector3d RenderJob::jitter(const math::PixelRandom &random, size_t sample) const
+    {
+        if(!m_model.jitter()) return (offset_h / 2) + (offset_v / 2);
+        return (random.uniform(sample, 0) * offset_h) + (random.uniform(sample, 1) * offset_v);
+    }
+
+    /*
+        Estimates the circle of confusion of the surface seen through des (a point on the focal plane)
+        by tracing a single pinhole ray, and returns an aperture sample count covering that circle
+        with roughly one lens sample per square pixel. In-focus pixels get a single (pinhole) sample.
+        Blur spilling in from neighbouring out-of-focus geometry is not accounted for.
+    */
+    size_t RenderJob::adaptive_aperture_samples(const Vector3d &des)
+    {
+        Vector3d dir = (des - m_camera.eye()).normalized();
+        Hit hit = m_model.scene()->closest_hit(Ray(m_camera.eye(), dir));
+
+        double lens_radius = m_camera.aperture_radius() / m_camera.up().length();
+        double focal_depth = (des - m_camera.eye()).dot(G);
+
+        //misses are treated as infinitely far away, blurring over the whole lens.
+        double blur = 1.0;
+        if(hit.hit())
+        {
+            double depth = hit.distance() * dir.dot(G);
+            blur = std::abs(depth - focal_depth) / depth;
+        }
+
+        double coc = (2.0 * lens_radius * blur) / pixel_size; //diameter in pixels
+        double samples = std::ceil(coc * coc);
+
+        if(samples <= 1.0) return 1;
+        if(samples >= m_camera.aperture_samples()) return m_camera.aperture_samples();
+        return size_t(samples);
+    }
+
+
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef RAYTRACER_RENDERING_RENDERJOB_HPP
+#define RAYTRACER_RENDERING_RENDERJOB_HPP
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <functional>
+
+#include "../camera.hpp"
+#include "../../core.hpp"
+#include "../../data/image.hpp"
+#include "../../data/framebuffer.hpp"
+#include "../../math/random.hpp"
+
+namespace raytracer
+{
+
+    class RenderModel; //circular dependency
+    class Ray;
+
+    //trace entry point of a rendermodel, specialized for its settings (see RenderModel::tracer).
+    typedef Vector3d (*TraceFunction)(const RenderModel &model, const Ray &ray, size_t reflections_left);
+
+    //rectangle of pixels, the unit of work handed to render threads.
+    struct Tile
+    {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+    };
+
+    class RenderJob;
+
+    /*
+        A finished tile, passed to the tile callback of the rendermodel. pixels point at the first
+        pixel of the tile (rows are stride pixels apart) and stay valid until the callback returns.
+        Callbacks run on the render threads, concurrently, returning false aborts the render.
+        Aborted renders still return their image, holding only the tiles finished so far, check
+        RenderJob::aborted or RenderModel::aborted to tell them apart from complete renders.
+    */
+    struct TileEvent
+    {
+        const RenderJob *job;
+        Tile tile;
+        const Vector3d *pixels;
+        size_t stride;
+        size_t tiles_done;
+        size_t tiles_total;
+    };
+
+    typedef std::function<bool(const TileEvent &event)> TileCallback;
+
+    /*
+        A single render of a RenderModel: owns the framebuffer, camera basis and work scheduling.
+        The job only reads from its model and the model's scene, so several jobs can run at the
+        same time against one model (a preview and a final render for example), as long as the
+        model and scene are not modified while they run.
+    */
+
+    class RenderJob : public Object
+    {
+    public:
+        RenderJob(const RenderModel &model, const Camera &camera);
+        RenderJob(const RenderJob&) = delete;
+        virtual ~RenderJob(); //deletes the image unless it was released
+
+        //renders the region into image(), allocating a region sized image when no target was set.
+        data::Image* render();
+        data::Image* render_threaded(size_t thread_count);
+
+        //restricts rendering to a rectangle of the frame, pixels are identical to a full render.
+        const Tile& region() const;
+        void region(const Tile &rect);
+
+        //renders into a full frame image or framebuffer owned by the caller, only the region is written.
+        //render and render_threaded return nullptr when rendering into a framebuffer.
+        void target(data::Image *image);
+        void target(data::FrameBuffer *framebuffer);
+
+        //renders row y of the frame into row (width() pixels)
+        void render_line(int y, Vector3d *row);
+        //renders pixels [x0, x1) of row y into out
+        void render_span(int y, size_t x0, size_t x1, Vector3d *out);
+
+        //tiles covering the region, render_tile writes into image() which must be allocated
+        //and returns the rendered pixels (without progress filled in).
+        std::vector<Tile> tiles() const;
+        TileEvent render_tile(const Tile &tile);
+
+        //readies the job for scheduling: allocates the image when no target was set, sizes the tile
+        //bookkeeping and picks the kernel for the current model settings. Called by TileScheduler::add.
+        void prepare();
+
+        //completed tiles are skipped by the scheduler, complete_tile is called after render_tile.
+        bool tile_completed(size_t index) const;
+        void complete_tile(size_t index);
+        //whether the last render stopped before every tile was completed (the tile callback aborted it).
+        bool aborted() const;
+
+        //writes the completed tiles to file at most every interval seconds while rendering (and when the
+        //render is aborted), resume loads such a file so only the missing tiles are rendered.
+        //Checkpoints are only valid for the same scene, camera and render settings and need an image target.
+        void checkpoint(const std::string &file, double interval);
+        void resume(const std::string &file);
+
+        const Camera& camera() const;
+        size_t width() const;
+        size_t height() const;
+
+        data::Image* image();
+        data::Image* release_image(); //caller takes ownership of allocated images
+        void allocate_image(); //region sized
+
+        virtual std::string to_string() const;
+
+    protected:
+        const RenderModel &m_model;
+        const Camera m_camera;
+        Tile m_region;
+
+        //image pixel (x, y) holds frame pixel (x + m_image_x, y + m_image_y)
+        data::Image *m_image;
+        bool m_owns_image;
+        size_t m_image_x, m_image_y;
+        data::FrameBuffer *m_framebuffer;
+
+        //tile bookkeeping and checkpoints
+        std::vector<char> m_completed;
+        std::mutex m_completed_lock;
+        std::string m_checkpoint_file;
+        double m_checkpoint_interval;
+        bool m_writing_checkpoint;
+        std::chrono::steady_clock::time_point m_last_checkpoint;
+
+        void prepare_tiles();
+        uint32_t fingerprint() const;
+        void write_checkpoint(const std::vector<char> &completed);
+
+        /*
+            Per row render types. The supersampled kernel is instantiated for the common supersample
+            counts (0 reads the count from the camera) with and without depth of field, so the sample
+            loops have constant bounds. select_kernel picks the kernel and tracer once per render.
+        */
+        typedef void (RenderJob::*Kernel)(int y, size_t x0, size_t x1, Vector3d *out);
+        Kernel m_kernel;
+        TraceFunction m_tracer;
+        void select_kernel();
+
+        void render_simple_threaded(int y, size_t x0, size_t x1, Vector3d *out);
+        template<size_t Supersamples, bool DepthOfField>
+        void render_supersampled_threaded(int y, size_t x0, size_t x1, Vector3d *out);
+        size_t adaptive_aperture_samples(const Vector3d &des);
+        Vector3d jitter(const math::PixelRandom &random, size_t sample) const;
+
+        //values used during all renderstages.
+        double pixel_size;
+        size_t img_w, img_h;
+        Vector3d G, A, B, H, V, origin, offset_h, offset_v;
+    };
+
+}
+
+#endif
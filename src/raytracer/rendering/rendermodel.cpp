@@ -1,7 +1,12 @@
 #include "rendermodel.hpp"
 
+#include <deque>
+#include <atomic>
 #include <chrono>
-#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
 
 namespace raytracer
 {
@@ -9,7 +14,19 @@ namespace raytracer
     RenderModel::RenderModel()
     {
         m_shadows = false;
+        m_adaptive_dof = false;
+        m_jitter = false;
+        m_frame = 0;
+        m_thread_pinning = false;
+        m_numa_replication = false;
         m_reflection_depth = 0;
+        m_tile_size = 32;
+        m_image_format = data::PixelFormat::RGB_DOUBLE;
+        m_out_of_core_threshold = 0;
+        m_checkpoint_interval = 0;
+        m_aborted = false;
+        m_focused = false;
+        m_focus_x = m_focus_y = 0.5;
         m_background_color = Vector3d(0.0);
 
         m_scene = nullptr;
@@ -23,326 +40,448 @@ namespace raytracer
 
     data::Image* RenderModel::render()
     {
-        if(!m_scene) throw Exception(__PRETTY_FUNCTION__, "no scene set");
-        
-        image = new data::Image(m_camera.image_width(), m_camera.image_height());
+        RenderJob job(*this, m_camera);
+        data::Image *rval = job.render();
+        m_aborted = job.aborted();
+        return rval;
+    }
 
-        img_w = m_camera.image_width();
-        img_h = m_camera.image_height();
+    data::Image* RenderModel::render_threaded(size_t thread_count)
+    {
+        RenderJob job(*this, m_camera);
+        if(!m_checkpoint_file.empty()) job.checkpoint(m_checkpoint_file, m_checkpoint_interval);
+        data::Image *rval = job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+        return rval;
+    }
 
-        pixel_size = m_camera.up().length();
-        G = (m_camera.center() - m_camera.eye()).normalized();
-        A = (G.cross(m_camera.up())).normalized();
-        B = (A.cross(G)).normalized();
+    data::Image* RenderModel::resume_threaded(size_t thread_count)
+    {
+        if(m_checkpoint_file.empty()) throw Exception(__PRETTY_FUNCTION__, "no checkpoint file set");
+
+        RenderJob job(*this, m_camera);
+        job.checkpoint(m_checkpoint_file, m_checkpoint_interval);
+        job.resume(m_checkpoint_file);
+        data::Image *rval = job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+        return rval;
+    }
 
-        H = pixel_size * A;
-        V = pixel_size * B;
-        origin = m_camera.center()
-            - ((m_camera.image_width() / 2) * H)
-            - ((m_camera.image_height() / 2) * V);
+    void RenderModel::render_threaded(data::Image &target, size_t thread_count)
+    {
+        RenderJob job(*this, m_camera);
+        job.target(&target);
+        job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+    }
 
-        offset_h = H / m_camera.supersamples();
-        offset_v = V / m_camera.supersamples();
+    void RenderModel::render_threaded(data::FrameBuffer &target, size_t thread_count)
+    {
+        RenderJob job(*this, m_camera);
+        job.target(&target);
+        job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+    }
 
-        
-        auto current_time = std::chrono::high_resolution_clock::now();
-        if(m_camera.supersamples() == 0) render_simple();
-        else if(m_camera.depth_of_field()) render_with_dof_and_supersampling();
-        else render_with_supersampling();
-        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - current_time).count();
+    data::Image* RenderModel::render_region_threaded(const Tile &region, size_t thread_count)
+    {
+        RenderJob job(*this, m_camera);
+        job.region(region);
+        data::Image *rval = job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+        return rval;
+    }
 
-        std::cout << "\rrender completed in " << (elapsed / 1000) << " seconds." << std::endl;
+    void RenderModel::render_region_threaded(const Tile &region, data::Image &target, size_t thread_count)
+    {
+        RenderJob job(*this, m_camera);
+        job.region(region);
+        job.target(&target);
+        job.render_threaded(thread_count);
+        m_aborted = job.aborted();
+    }
 
-        return image;
+    std::vector<data::Image*> RenderModel::render_batch_threaded(const std::vector<Camera> &cameras, size_t thread_count)
+    {
+        if(!m_scene) throw Exception(__PRETTY_FUNCTION__, "no scene set");
+
+        std::vector<RenderJob*> jobs;
+        TileScheduler scheduler(*this);
+
+        for(const Camera &cam : cameras)
+        {
+            jobs.push_back(new RenderJob(*this, cam));
+            scheduler.add(jobs.back());
+        }
+
+        scheduler.run(thread_count);
+        m_aborted = scheduler.aborted();
+
+        std::vector<data::Image*> rval;
+        for(RenderJob *job : jobs)
+        {
+            rval.push_back(job->release_image());
+            delete job;
+        }
+        return rval;
+    }
+
+    static Vector3d trace_virtual(const RenderModel &model, const Ray &ray, size_t reflections_left)
+    {
+        return model.trace(ray, reflections_left);
     }
 
-    Vector3d RenderModel::trace(const Ray &ray, size_t reflections)
+    TraceFunction RenderModel::tracer() const { return &trace_virtual; }
+
+    Vector3d RenderModel::trace(const Ray &ray, size_t reflections) const
     {
         Hit min_hit = m_scene->closest_hit(ray);
 
-        if(min_hit.hit()) return min_hit.shape()->color_at(ray.at(min_hit.distance()));
-        return Vector3d();
+        if(min_hit.missed()) return Vector3d();
+
+        Vector3d dx, dy;
+        ray.point_differentials(min_hit.distance(), min_hit.normal(), dx, dy);
+        return min_hit.shape()->color_at(ray.at(min_hit.distance()), dx, dy);
     }
 
     bool RenderModel::shadows() const { return m_shadows; }
     void RenderModel::enable_shadows() { m_shadows = true; }
     void RenderModel::disable_shadows() { m_shadows = false; }
-    Scene* RenderModel::scene() { return m_scene; }
-    void RenderModel::scene(Scene *scene) { m_scene = scene; }
+    bool RenderModel::jitter() const { return m_jitter; }
+    void RenderModel::enable_jitter() { m_jitter = true; }
+    void RenderModel::disable_jitter() { m_jitter = false; }
+    size_t RenderModel::frame() const { return m_frame; }
+    void RenderModel::frame(size_t f) { m_frame = f; }
+    bool RenderModel::adaptive_dof() const { return m_adaptive_dof; }
+    void RenderModel::enable_adaptive_dof() { m_adaptive_dof = true; }
+    void RenderModel::disable_adaptive_dof() { m_adaptive_dof = false; }
+    Scene* RenderModel::scene() const { return m_scene; }
+
+    void RenderModel::scene(Scene *scene)
+    {
+        m_scene = scene;
+        replicate_scene();
+    }
+
     Camera RenderModel::camera() const { return m_camera; }
     void RenderModel::camera(const Camera &cam) { m_camera = cam; }
     size_t RenderModel::reflection_depth() const { return m_reflection_depth; }
     void RenderModel::reflection_depth(size_t rd) { m_reflection_depth = rd; }
+    size_t RenderModel::tile_size() const { return m_tile_size; }
+    void RenderModel::tile_size(size_t ts) { m_tile_size = ts; }
+    void RenderModel::checkpoint(const std::string &file, double interval)
+    {
+        m_checkpoint_file = file;
+        m_checkpoint_interval = interval;
+    }
 
-    std::string RenderModel::to_string() const
+    void RenderModel::disable_checkpoints() { m_checkpoint_file = ""; }
+    data::PixelFormat RenderModel::image_format() const { return m_image_format; }
+
+    void RenderModel::image_format(data::PixelFormat format)
     {
-        return "raytracer::RenderModel";
+        if(!data::Image::storable(format)) throw Exception(__PRETTY_FUNCTION__, "images can not be stored as " + data::format_name(format));
+        m_image_format = format;
     }
 
-    ///////////////////////////////////////////////////////////////////////////////////////////////////
-    // Threaded functions (public & private)
-    ///////////////////////////////////////////////////////////////////////////////////////////////////
-    void worker(RenderModel *model)
+    void RenderModel::out_of_core(const std::string &directory, size_t threshold)
     {
-        std::vector<Vector3d> storage;
+        m_out_of_core_directory = directory;
+        m_out_of_core_threshold = threshold;
+    }
 
-        int y = model->get_work(0);
-        while(y != -1)
-        {
-            storage.clear();
-            storage.reserve(model->img_w);
+    void RenderModel::disable_out_of_core() { m_out_of_core_directory = ""; }
 
-            if(model->m_camera.supersamples() == 0) model->render_simple_threaded(y);
-            else if(model->m_camera.depth_of_field()) model->render_with_dof_and_supersampling_threaded(y);
-            else model->render_with_supersampling_threaded(y);
+    data::Image* RenderModel::allocate_image(size_t w, size_t h) const
+    {
+        size_t bytes = w * h * (m_image_format == data::PixelFormat::RGB_DOUBLE ? sizeof(Vector3d) : data::pixel_size(m_image_format));
+        if(m_out_of_core_directory.empty() || bytes < m_out_of_core_threshold || bytes == 0)
+            return new data::Image(w, h, m_image_format);
 
-            y = model->get_work(y);
-        }
+        static std::atomic<size_t> counter(0);
+        std::string file = m_out_of_core_directory + "/eztrace-" + std::to_string(getpid()) + "-" + std::to_string(counter++) + ".image";
+        return new data::Image(w, h, m_image_format, file);
     }
 
-    int RenderModel::get_work(int y)
+    bool RenderModel::focused() const { return m_focused; }
+    double RenderModel::focus_x() const { return m_focus_x; }
+    double RenderModel::focus_y() const { return m_focus_y; }
+
+    void RenderModel::focus(double x, double y)
     {
-        thread_lock.lock(); //synchronize
+        m_focused = true;
+        m_focus_x = x;
+        m_focus_y = y;
+    }
 
-        //assign next line
-        int rval = current < img_h ? current : -1;
-        ++current;
+    void RenderModel::disable_focus() { m_focused = false; }
+    const std::vector<Tile>& RenderModel::marked_regions() const { return m_marked_regions; }
+    void RenderModel::mark_region(const Tile &rect) { m_marked_regions.push_back(rect); }
+    void RenderModel::clear_marked_regions() { m_marked_regions.clear(); }
+    const TileCallback& RenderModel::tile_callback() const { return m_tile_callback; }
+    void RenderModel::tile_callback(const TileCallback &callback) { m_tile_callback = callback; }
+    bool RenderModel::aborted() const { return m_aborted; }
+    bool RenderModel::thread_pinning() const { return m_thread_pinning; }
+    void RenderModel::enable_thread_pinning() { m_thread_pinning = true; }
+    void RenderModel::disable_thread_pinning() { m_thread_pinning = false; }
+    bool RenderModel::numa_replication() const { return m_numa_replication; }
+
+    void RenderModel::enable_numa_replication()
+    {
+        m_numa_replication = true;
+        replicate_scene();
+    }
 
-        //update console?
-        float progress = ((float)current / (float)(img_h - 1.0)) * 100;
-        size_t pr = floor(progress);
-        if(pr != reported)
-        {
-            std::cout << "\rProgress: " << pr << "%" << std::flush;
-            reported = pr;
-        }
+    void RenderModel::disable_numa_replication() { m_numa_replication = false; }
 
-        thread_lock.unlock(); //unsync
-        return rval; //return next task.
+    //before any job renders, jobs only read the replicas.
+    void RenderModel::replicate_scene()
+    {
+        if(m_scene && m_numa_replication && m_topology.node_count() > 1) m_scene->replicate(m_topology);
     }
 
-    data::Image* RenderModel::render_threaded(size_t thread_count)
-    {
-        if(!m_scene) throw Exception(__PRETTY_FUNCTION__, "no scene set");   
-        image = new data::Image(m_camera.image_width(), m_camera.image_height());
+    const CpuTopology& RenderModel::topology() const { return m_topology; }
 
-        img_w = m_camera.image_width();
-        img_h = m_camera.image_height();
+    std::string RenderModel::to_string() const
+    {
+        return "raytracer::RenderModel";
+    }
 
-        pixel_size = m_camera.up().length();
-        G = (m_camera.center() - m_camera.eye()).normalized();
-        A = (G.cross(m_camera.up())).normalized();
-        B = (A.cross(G)).normalized();
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    // Distributed functions
+    ///////////////////////////////////////////////////////////////////////////////////////////////////
+    static const uint32_t rows_per_assignment = 4;
 
-        H = pixel_size * A;
-        V = pixel_size * B;
-        origin = m_camera.center()
-            - ((m_camera.image_width() / 2) * H)
-            - ((m_camera.image_height() / 2) * V);
+    data::Image* RenderModel::render_distributed(size_t process_count)
+    {
+        if(!m_scene) throw Exception(__PRETTY_FUNCTION__, "no scene set");
 
-        offset_h = H / m_camera.supersamples();
-        offset_v = V / m_camera.supersamples();
+        std::vector<int> connections;
+        std::vector<pid_t> children;
+        std::cout << std::flush; //dont let the children inherit buffered output
 
-        auto current_time = std::chrono::high_resolution_clock::now();
-        current = 0;
-        reported = 0;
-        std::vector<std::thread> threads;
-        threads.reserve(thread_count - 1);
-        
-        //spawn the threads
-        for(size_t i = 0; i < thread_count - 1; ++i)
+        for(size_t i = 0; i < process_count; ++i)
         {
-            threads.push_back(std::thread(worker, this));
-        }
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) break;
 
-        //when subthreads are spawned start working ourself
-        worker(this);
+            pid_t pid = fork();
+            if(pid == 0)
+            {
+                //worker process, renders with its own copy of the scene.
+                for(int fd : connections) close(fd);
+                close(fds[0]);
+
+                int status = 0;
+                try { serve(fds[1]); }
+                catch(const std::exception &ex) { std::cerr << ex.what() << std::endl; status = 1; }
+                _exit(status);
+            }
 
-        //when were done wait for other threads to complete
-        for(size_t i = 0; i < thread_count - 1; ++i)
-        {
-            threads[i].join();
+            close(fds[1]);
+            if(pid < 0) { close(fds[0]); break; }
+
+            connections.push_back(fds[0]);
+            children.push_back(pid);
         }
 
-        //all threads are done so the image must be aswell.
+        data::Image *rval = nullptr;
+        try { rval = render_distributed(connections); }
+        catch(...)
+        {
+            for(int fd : connections) close(fd);
+            for(pid_t pid : children) waitpid(pid, nullptr, 0);
+            throw;
+        }
 
-        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - current_time).count();
-        std::cout << "\rrender completed in " << (elapsed / 1000) << " seconds on " << thread_count << " threads." << std::endl;
-        return image;
+        for(int fd : connections) close(fd);
+        for(pid_t pid : children) waitpid(pid, nullptr, 0);
+        return rval;
     }
 
-    void RenderModel::render_simple_threaded(int y)
+    data::Image* RenderModel::render_distributed(const std::vector<int> &connections)
     {
-        for(size_t x = 0; x < img_w; ++x)
+        if(connections.empty()) throw Exception(__PRETTY_FUNCTION__, "no workers");
+        RenderJob job(*this, m_camera);
+        size_t img_w = job.width();
+        size_t img_h = job.height();
+
+        auto current_time = std::chrono::high_resolution_clock::now();
+        data::Image *result = allocate_image(img_w, img_h);
+
+        std::vector<bool> alive(connections.size(), true);
+        std::vector<std::deque<Assignment>> pending(connections.size());
+        std::deque<Assignment> requeued; //work of workers that dropped out
+        uint32_t next = 0;
+        size_t done = 0;
+
+        //hands the worker its next assignment, false when there is nothing left to do.
+        auto assign = [&](size_t w) -> bool
         {
-            Vector3d pixel(x + 0.5, img_h - 1 - y - 0.6, 0);
-            Ray ray(m_camera.eye(), (pixel - m_camera.eye()).normalized());
-            Vector3d color = trace(ray, 0);
+            Assignment as;
+            if(!requeued.empty()) { as = requeued.front(); requeued.pop_front(); }
+            else if(next < img_h) { as.y = next; as.rows = std::min<uint32_t>(rows_per_assignment, img_h - next); next += as.rows; }
+            else return false;
 
-            image->set_pixel(color, x, y);
-        }
-    }
+            pending[w].push_back(as);
+            write_all(connections[w], &as, sizeof(as));
+            return true;
+        };
 
-    void RenderModel::render_with_supersampling_threaded(int y)
-    {
-        for(size_t x = 0; x < img_w; ++x)
+        auto drop = [&](size_t w)
         {
-            Vector3d average(0.0);
-            Vector3d pixel = origin + x * H + (img_h - pixel_size - y) * V;
+            alive[w] = false;
+            requeued.insert(requeued.end(), pending[w].begin(), pending[w].end());
+            pending[w].clear();
+        };
 
-            for(size_t i = 0; i < m_camera.supersamples(); ++i)
+        FrameHeader header = { distributed_magic, uint32_t(img_w), uint32_t(img_h), uint32_t(m_frame) };
+        for(size_t w = 0; w < connections.size(); ++w)
+        {
+            try
             {
-                for(size_t j = 0; j < m_camera.supersamples(); ++j)
-                {
-                    Vector3d des = pixel + (i * offset_h) + (j * offset_v);
-                    des = des + (offset_h / 2) + (offset_v / 2);
-                    Ray ray(m_camera.eye(), (des - m_camera.eye()).normalized());
-                    average += trace(ray, m_reflection_depth);
-                }
+                write_all(connections[w], &header, sizeof(header));
+                //two assignments in flight hide the round trip.
+                assign(w); assign(w);
             }
-            average /= (m_camera.supersamples() * m_camera.supersamples());
-            image->set_pixel(average, x, y);
+            catch(const Exception &ex) { drop(w); }
         }
-    }
 
-    void RenderModel::render_with_dof_and_supersampling_threaded(int y)
-    {
-        for(size_t x = 0; x < img_w; ++x)
-        {
-            Vector3d average(0.0);
-            Vector3d pixel = origin + x * H + (img_h - pixel_size - y) * V;
+        std::vector<double> buffer(rows_per_assignment * img_w * 3);
+        std::vector<Vector3d> rows(rows_per_assignment * img_w); //decoded, also what the tile callback sees
+        size_t bands = (img_h + rows_per_assignment - 1) / rows_per_assignment;
+        size_t bands_done = 0;
+        m_aborted = false;
 
-            double c = m_camera.aperture_radius() / (m_camera.up().length() * sqrt(m_camera.aperture_samples()));
-
-            //loop through dof angles
-            for(size_t dof = 0; dof < m_camera.aperture_samples(); ++dof)
+        while(done < img_h && !m_aborted)
+        {
+            std::vector<pollfd> fds;
+            std::vector<size_t> owners;
+            for(size_t w = 0; w < connections.size(); ++w)
             {
-                double r = c * sqrt(dof);
-                //last part = golden angle
-                double theta = dof * (180.0 * (3.0 - sqrt(5.0)));
-                Vector3d dofeye = m_camera.eye();
+                if(!alive[w]) continue;
 
-                dofeye += (r * A * cos(theta)); //y displacement
-                dofeye += (r * m_camera.up() * sin(theta)); //x displacement
-
-                //supersample dof angles
-                for(size_t i = 0; i < m_camera.supersamples(); ++i)
+                //idle workers pick up work dropped by others.
+                if(pending[w].empty())
                 {
-                    for(size_t j = 0; j < m_camera.supersamples(); ++j)
-                    {
-                        Vector3d des = pixel + (i * offset_h) + (j * offset_v);
-                        des = des + (offset_h / 2) + (offset_v / 2);
-                        Ray ray(dofeye, (des - dofeye).normalized());
-                        average += trace(ray, m_reflection_depth);
-                    }
+                    try { if(!assign(w)) continue; }
+                    catch(const Exception &ex) { drop(w); continue; }
                 }
+                fds.push_back({ connections[w], POLLIN, 0 });
+                owners.push_back(w);
             }
-            average /= (m_camera.supersamples() * m_camera.supersamples()) * m_camera.aperture_samples();
-            image->set_pixel(average, x, y);
-        }
-    }
-
-
-    ///////////////////////////////////////////////////////////////////////////////////////////////////
-    // Big render functions
-    ///////////////////////////////////////////////////////////////////////////////////////////////////
-    void RenderModel::render_simple()
-    {
-        for(size_t y = 0; y < img_h; ++y)
-            render_simple_threaded(y);
-    }
 
-    void RenderModel::render_with_supersampling()
-    {
-        for(size_t y = 0; y < img_h; ++y)
-            render_with_supersampling_threaded(y);
-    }
-
-    void RenderModel::render_with_dof_and_supersampling()
-    {
-        for(size_t y = 0; y < img_h; ++y)
-            render_with_dof_and_supersampling_threaded(y);
-    }
-    
-    /*
-    void RenderModel::render_simple()
-    {
-        for(size_t x = 0; x < img_w; ++x)
-            for(size_t y = 0; y < img_h; ++y)
+            if(fds.empty())
             {
-                Vector3d pixel(x + 0.5, img_h - 1 - y - 0.6, 0);
-                Ray ray(m_camera.eye(), (pixel - m_camera.eye()).normalized());
-                Vector3d color = trace(ray, 0);
-
-                image->set_pixel(color, x, y);
+                delete result;
+                throw Exception(__PRETTY_FUNCTION__, "all workers dropped out");
             }
-    }
 
-    void RenderModel::render_with_supersampling()
-    {   
-        for(size_t y = 0; y < img_h; ++y)
-        {
-            std::cout << "\rAt line " << y + 1 << "/" << img_h << std::flush;
-            for(size_t x = 0; x < img_w; ++x)
+            if(poll(fds.data(), fds.size(), -1) < 0) continue;
+
+            for(size_t i = 0; i < fds.size(); ++i)
             {
-                Vector3d average(0.0);
-                Vector3d pixel = origin + x * H + (img_h - pixel_size - y) * V;
+                if(fds[i].revents == 0) continue;
+                size_t w = owners[i];
 
-                for(size_t i = 0; i < m_camera.supersamples(); ++i)
+                try
                 {
-                    for(size_t j = 0; j < m_camera.supersamples(); ++j)
+                    Assignment as;
+                    read_all(connections[w], &as, sizeof(as));
+                    if(as.y != pending[w].front().y || as.rows != pending[w].front().rows)
+                        throw Exception(__PRETTY_FUNCTION__, "unexpected assignment from worker");
+
+                    read_all(connections[w], buffer.data(), as.rows * img_w * 3 * sizeof(double));
+                    pending[w].pop_front();
+
+                    //stored through the image, which may be compact or mapped (no pixel references)
+                    const double *value = buffer.data();
+                    for(size_t p = 0; p < as.rows * img_w; ++p, value += 3)
+                        rows[p] = Vector3d(value[0], value[1], value[2]);
+                    for(size_t r = 0; r < as.rows; ++r)
+                        result->store(0, as.y + r, &rows[r * img_w], img_w);
+
+                    done += as.rows;
+                    ++bands_done;
+
+                    if(m_tile_callback)
                     {
-                        Vector3d des = pixel + (i * offset_h) + (j * offset_v);
-                        des = des + (offset_h / 2) + (offset_v / 2);
-                        Ray ray(m_camera.eye(), (des - m_camera.eye()).normalized());
-                        average += trace(ray, m_reflection_depth);
+                        TileEvent event = { &job, Tile{ 0, as.y, img_w, as.rows }, rows.data(), img_w, bands_done, bands };
+                        if(!m_tile_callback(event)) { m_aborted = true; break; }
                     }
+
+                    assign(w);
+                }
+                catch(const Exception &ex)
+                {
+                    std::cerr << "dropping worker " << w << ": " << ex.what() << std::endl;
+                    drop(w);
                 }
-                average /= (m_camera.supersamples() * m_camera.supersamples());
-                image->set_pixel(average, x, y);
             }
         }
-    }
 
-    void RenderModel::render_with_dof_and_supersampling()
-    {
-        for(size_t y = 0; y < img_h; ++y)
+        //end of frame
+        Assignment end = { 0, 0 };
+        for(size_t w = 0; w < connections.size(); ++w)
         {
-            std::cout << "\rAt line " << y + 1 << "/" << img_h << std::flush;
-            for(size_t x = 0; x < img_w; ++x)
-            {
-                Vector3d average(0.0);
-                Vector3d pixel = origin + x * H + (img_h - pixel_size - y) * V;
-
-                double c = m_camera.aperture_radius() / (m_camera.up().length() * sqrt(m_camera.aperture_samples()));
+            if(!alive[w]) continue;
+            try { write_all(connections[w], &end, sizeof(end)); }
+            catch(const Exception &ex) { }
+        }
 
-                //loop through dof angles
-                for(size_t dof = 0; dof < m_camera.aperture_samples(); ++dof)
-                {
-                    double r = c * sqrt(dof);
-                    //last part = golden angle
-                    double theta = dof * (180.0 * (3.0 - sqrt(5.0)));
-                    Vector3d dofeye = m_camera.eye();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - current_time).count();
+        std::cout << "\rrender completed in " << (elapsed / 1000) << " seconds on " << connections.size() << " workers." << std::endl;
+        return result;
+    }
 
-                    dofeye += (r * A * cos(theta)); //y displacement
-                    dofeye += (r * m_camera.up() * sin(theta)); //x displacement
+    void RenderModel::serve(int connection, size_t thread_count)
+    {
+        if(!m_scene) throw Exception(__PRETTY_FUNCTION__, "no scene set");
 
-                    //supersample dof angles
-                    for(size_t i = 0; i < m_camera.supersamples(); ++i)
-                    {
-                        for(size_t j = 0; j < m_camera.supersamples(); ++j)
-                        {
-                            Vector3d des = pixel + (i * offset_h) + (j * offset_v);
-                            des = des + (offset_h / 2) + (offset_v / 2);
-                            Ray ray(dofeye, (des - dofeye).normalized());
-                            average += trace(ray, m_reflection_depth);
-                        }
-                    }
-                }
-                average /= (m_camera.supersamples() * m_camera.supersamples()) * m_camera.aperture_samples();
-                image->set_pixel(average, x, y);
+        RenderJob job(*this, m_camera);
+        size_t img_w = job.width();
+        size_t img_h = job.height();
+
+        FrameHeader header;
+        read_all(connection, &header, sizeof(header));
+        if(header.magic != distributed_magic) throw Exception(__PRETTY_FUNCTION__, "not a render coordinator");
+        if(header.width != img_w || header.height != img_h)
+            throw Exception(__PRETTY_FUNCTION__, "frame dimensions differ from the camera");
+        if(header.frame != uint32_t(m_frame))
+            throw Exception(__PRETTY_FUNCTION__, "frame number differs from the coordinator");
+
+        //assignments are rendered as regions of the job, into a frame sized rgb double target.
+        data::Image frame(img_w, img_h);
+        job.target(&frame);
+
+        std::vector<Vector3d> rows(rows_per_assignment * img_w);
+        std::vector<double> buffer(rows_per_assignment * img_w * 3);
+        while(true)
+        {
+            Assignment as;
+            read_all(connection, &as, sizeof(as));
+            if(as.rows == 0) break;
+            if(as.rows > rows_per_assignment || as.y + as.rows > img_h)
+                throw Exception(__PRETTY_FUNCTION__, "invalid assignment");
+
+            job.region(Tile{ 0, as.y, img_w, as.rows });
+            TileScheduler scheduler(*this, false);
+            scheduler.add(&job);
+            scheduler.run(thread_count);
+
+            for(size_t r = 0; r < as.rows; ++r)
+                frame.load(0, as.y + r, &rows[r * img_w], img_w);
+
+            double *value = buffer.data();
+            for(size_t i = 0; i < as.rows * img_w; ++i)
+            {
+                *(value++) = rows[i].m_x;
+                *(value++) = rows[i].m_y;
+                *(value++) = rows[i].m_z;
             }
+
+            write_all(connection, &as, sizeof(as));
+            write_all(connection, buffer.data(), as.rows * img_w * 3 * sizeof(double));
         }
     }
-    */
 }
\ No newline at end of file
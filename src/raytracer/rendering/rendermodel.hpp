@@ -1,8 +1,6 @@
 #ifndef RAYTRACER_RENDERING_RENDERMODEL_HPP
 #define RAYTRACER_RENDERING_RENDERMODEL_HPP
 
-#include <mutex>
-
 #include "../hit.hpp"
 #include "../ray.hpp"
 #include "../scene.hpp"
@@ -12,6 +10,10 @@
 #include "../../core.hpp"
 #include "../shapes/shape.hpp"
 #include "../../data/image.hpp"
+#include "threading.hpp"
+#include "distributed.hpp"
+#include "renderjob.hpp"
+#include "tilescheduler.hpp"
 
 namespace raytracer
 {
@@ -22,11 +24,30 @@ namespace raytracer
         RenderModel();
         virtual ~RenderModel();
 
+        //renders a job with the camera of this model, use RenderJob directly for concurrent renders.
         virtual data::Image* render();
-        virtual Vector3d trace(const Ray &ray, size_t reflections_left);
+        virtual Vector3d trace(const Ray &ray, size_t reflections_left) const;
+        //trace specialized for the current settings, picked once per render. Calls trace by default.
+        virtual TraceFunction tracer() const;
 
         //threaded callers
         virtual data::Image* render_threaded(size_t thread_count);
+        //continues the render saved in the checkpoint file (see checkpoint).
+        virtual data::Image* resume_threaded(size_t thread_count);
+        //render into memory owned by the caller, which can be reused for every frame.
+        virtual void render_threaded(data::Image &target, size_t thread_count);
+        virtual void render_threaded(data::FrameBuffer &target, size_t thread_count);
+        //renders only the pixels inside region, either as a region sized image or into target (a full frame).
+        virtual data::Image* render_region_threaded(const Tile &region, size_t thread_count);
+        virtual void render_region_threaded(const Tile &region, data::Image &target, size_t thread_count);
+        //renders a view for every camera, the tiles of all views share one pool of threads.
+        virtual std::vector<data::Image*> render_batch_threaded(const std::vector<Camera> &cameras, size_t thread_count);
+
+        //distributed rendering (see distributed.hpp), forks local worker processes or uses
+        //connections to remote workers, serve renders the assignments of a single frame on thread_count threads.
+        virtual data::Image* render_distributed(size_t process_count);
+        virtual data::Image* render_distributed(const std::vector<int> &connections);
+        virtual void serve(int connection, size_t thread_count = 1);
 
         /*
             Setters & Getters
@@ -35,7 +56,21 @@ namespace raytracer
         void enable_shadows();
         void disable_shadows();
 
-        Scene* scene();
+        //randomizes sample positions, random numbers are a pure function of pixel, sample and frame.
+        bool jitter() const;
+        void enable_jitter();
+        void disable_jitter();
+
+        //frame number the random numbers are keyed on.
+        size_t frame() const;
+        void frame(size_t f);
+
+        //scales aperture samples per pixel to its estimated circle of confusion.
+        bool adaptive_dof() const;
+        void enable_adaptive_dof();
+        void disable_adaptive_dof();
+
+        Scene* scene() const;
         void scene(Scene *s);
 
         Camera camera() const;
@@ -44,41 +79,84 @@ namespace raytracer
         size_t reflection_depth() const;
         void reflection_depth(size_t rd);
 
+        //pixel storage of the images allocated by renders (see data::Image), rgb double by default.
+        data::PixelFormat image_format() const;
+        void image_format(data::PixelFormat format);
+
+        //images of at least threshold bytes are stored in a memory mapped file in directory.
+        void out_of_core(const std::string &directory, size_t threshold);
+        void disable_out_of_core();
+        //allocates a render result following the settings above, caller takes ownership.
+        data::Image* allocate_image(size_t w, size_t h) const;
+
+        //width and height of the tiles render threads work on.
+        size_t tile_size() const;
+        void tile_size(size_t ts);
+
+        //threaded renders hand out the tiles in marked regions first, then the tiles closest to the
+        //focus point (x and y as fraction of the frame), instead of top to bottom.
+        bool focused() const;
+        double focus_x() const;
+        double focus_y() const;
+        void focus(double x, double y);
+        void disable_focus();
+        const std::vector<Tile>& marked_regions() const;
+        void mark_region(const Tile &rect); //in pixels of the full frame
+        void clear_marked_regions();
+
+        //threaded renders save their progress to file every interval seconds, so they can be resumed.
+        void checkpoint(const std::string &file, double interval);
+        void disable_checkpoints();
+
+        //called for every finished tile (see TileEvent), use console_progress() for console output.
+        const TileCallback& tile_callback() const;
+        void tile_callback(const TileCallback &callback);
+        //whether the tile callback aborted the last render, its image only holds the finished tiles.
+        bool aborted() const;
+
+        //pins each render thread to its own cpu, spread over the numa nodes.
+        bool thread_pinning() const;
+        void enable_thread_pinning();
+        void disable_thread_pinning();
+
+        //gives every numa node its own copy of the scene data, only useful with pinning enabled.
+        //The scene is replicated when it is set or replication is enabled, never while rendering,
+        //so shapes added to the scene after that are not replicated.
+        bool numa_replication() const;
+        void enable_numa_replication();
+        void disable_numa_replication();
+        const CpuTopology& topology() const;
+
         virtual std::string to_string() const; //lekker later
 
     protected:
-        friend void worker(RenderModel *model);
-
         bool m_shadows;
+        bool m_adaptive_dof;
+        bool m_jitter;
+        size_t m_frame;
+        bool m_thread_pinning;
+        bool m_numa_replication;
         size_t m_reflection_depth;
+        size_t m_tile_size;
+        data::PixelFormat m_image_format;
+        std::string m_out_of_core_directory;
+        size_t m_out_of_core_threshold;
+        TileCallback m_tile_callback;
+        bool m_aborted;
+        bool m_focused;
+        double m_focus_x, m_focus_y;
+        std::vector<Tile> m_marked_regions;
+        std::string m_checkpoint_file;
+        double m_checkpoint_interval;
         Vector3d m_background_color;
 
-        //default render types.
-        virtual void render_simple();
-        virtual void render_with_supersampling();
-        virtual void render_with_dof_and_supersampling();
-
-        //Threaded funcions
-        size_t reported;
-        size_t current;
-        std::mutex thread_lock;
-        int get_work(int y);
-        void render_simple_threaded(int y);
-        void render_with_supersampling_threaded(int y);
-        void render_with_dof_and_supersampling_threaded(int y);
-
         Scene *m_scene;
         Camera m_camera;
+        CpuTopology m_topology;
 
-        //values used during all renderstages.
-        double pixel_size;
-        size_t img_w, img_h;
-        data::Image *image;
-        Vector3d G, A, B, H, V, origin, offset_h, offset_v;
+        void replicate_scene();
     };
 
-    void worker(RenderModel *model);
-
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "sequencerenderer.hpp"
+
+#include <future>
+#include <memory>
+#include "../../data/imagewriter.hpp"
+
+namespace raytracer
+{
+
+    SequenceRenderer::SequenceRenderer(RenderModel &model, size_t thread_count)
+        : m_model(model), m_thread_count(thread_count) { }
+
+    //gives the model back the scene it had before the sequence, on every exit.
+    struct SceneRestore
+    {
+        RenderModel &model;
+        Scene *scene;
+        ~SceneRestore() { model.scene(scene); }
+    };
+
+    void SequenceRenderer::render(size_t frame_count, const PrepareFunction &prepare)
+    {
+        if(frame_count == 0) return;
+
+        SceneRestore restore = { m_model, m_model.scene() };
+        std::future<SequenceFrame> preparing = std::async(std::launch::async, prepare, 0);
+        data::ImageWriter writer(1);
+        std::future<void> encoding;
+
+        try
+        {
+            for(size_t n = 0; n < frame_count; ++n)
+            {
+                SequenceFrame frame = preparing.get();
+                std::unique_ptr<Scene> owned(frame.delete_scene ? frame.scene : nullptr);
+                if(n + 1 < frame_count) preparing = std::async(std::launch::async, prepare, n + 1);
+
+                m_model.scene(frame.scene);
+                m_model.camera(frame.camera);
+                m_model.frame(n);
+                std::unique_ptr<data::Image> image(m_model.render_threaded(m_thread_count)); //owned until handed to the writer
+                owned.reset();
+
+                //frame N-1 encoded while N rendered, only keep one encode in flight.
+                if(encoding.valid()) encoding.get(); //rethrows encode errors, image is freed then
+                encoding = writer.write(image.release(), frame.file);
+            }
+        }
+        catch(...)
+        {
+            //the frame prepared ahead is never rendered
+            if(preparing.valid())
+            {
+                try
+                {
+                    SequenceFrame next = preparing.get();
+                    if(next.delete_scene) delete next.scene;
+                }
+                catch(...) { }
+            }
+            throw;
+        }
+
+        encoding.get();
+    }
+
+    std::string SequenceRenderer::to_string() const
+    {
+        return "raytracer::SequenceRenderer - " + std::to_string(m_thread_count) + " threads";
+    }
+
+}
@@ -0,0 +1,45 @@
+#ifndef RAYTRACER_RENDERING_SEQUENCERENDERER_HPP
+#define RAYTRACER_RENDERING_SEQUENCERENDERER_HPP
+
+#include <functional>
+#include "rendermodel.hpp"
+
+namespace raytracer
+{
+
+    //one frame of a sequence, as produced by the prepare callback.
+    struct SequenceFrame
+    {
+        Scene *scene;
+        Camera camera;
+        std::string file;
+        bool delete_scene; //the scene is deleted after this frame rendered.
+    };
+
+    /*
+        Renders a sequence of frames with the stages pipelined:
+        while frame N renders, frame N+1 is prepared and frame N-1 is encoded, each on its own thread.
+        The prepare callback runs concurrently with the render of the previous frame, so it must not
+        modify a scene that frame still uses (return a new scene, or reuse one that is not rendering).
+        The model gets its own scene back when render returns or throws.
+    */
+
+    class SequenceRenderer : public Object
+    {
+    public:
+        typedef std::function<SequenceFrame(size_t frame)> PrepareFunction;
+
+        SequenceRenderer(RenderModel &model, size_t thread_count);
+
+        void render(size_t frame_count, const PrepareFunction &prepare);
+
+        virtual std::string to_string() const;
+
+    protected:
+        RenderModel &m_model;
+        size_t m_thread_count;
+    };
+
+}
+
+#endif
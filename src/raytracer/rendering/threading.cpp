@@ -0,0 +1,108 @@
+#include "threading.hpp"
+
+#include <thread>
+#include <fstream>
+
+#ifdef __linux__
+    #include <sched.h>
+#endif
+
+namespace raytracer
+{
+
+    static thread_local size_t current_numa_node = 0;
+
+    //parses a sysfs cpulist like "0-3,8-11"
+    static std::vector<int> parse_cpulist(const std::string &list)
+    {
+        std::vector<int> cpus;
+        for(const std::string &range : split(trim(list), ','))
+        {
+            if(range.empty()) continue;
+            std::vector<std::string> bounds = split(range, '-');
+            int first = std::stoi(bounds[0]);
+            int last = bounds.size() > 1 ? std::stoi(bounds[1]) : first;
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    CpuTopology::CpuTopology()
+    {
+#ifdef __linux__
+        for(size_t node = 0; ; ++node)
+        {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if(in.fail()) break;
+
+            std::vector<int> cpus = parse_cpulist(get_line(in));
+            if(!cpus.empty()) m_nodes.push_back(cpus);
+        }
+#endif
+
+        if(m_nodes.empty())
+        {
+            size_t count = std::max(1u, std::thread::hardware_concurrency());
+            m_nodes.push_back(std::vector<int>());
+            for(size_t cpu = 0; cpu < count; ++cpu)
+                m_nodes[0].push_back(cpu);
+        }
+    }
+
+    size_t CpuTopology::node_count() const { return m_nodes.size(); }
+    const std::vector<int>& CpuTopology::cpus(size_t node) const { return m_nodes[node]; }
+
+    int CpuTopology::worker_cpu(size_t worker) const
+    {
+        const std::vector<int> &node = m_nodes[worker_node(worker)];
+        return node[(worker / m_nodes.size()) % node.size()];
+    }
+
+    size_t CpuTopology::worker_node(size_t worker) const
+    {
+        return worker % m_nodes.size();
+    }
+
+    std::string CpuTopology::to_string() const
+    {
+        std::string s = "raytracer::CpuTopology\n";
+        for(size_t node = 0; node < m_nodes.size(); ++node)
+            s += "    node " + std::to_string(node) + ": " + std::to_string(m_nodes[node].size()) + " cpus\n";
+        return s;
+    }
+
+    bool pin_current_thread(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    size_t numa_node() { return current_numa_node; }
+    void numa_node(size_t node) { current_numa_node = node; }
+
+    AffinityGuard::AffinityGuard() : m_node(current_numa_node)
+    {
+#ifdef __linux__
+        m_mask.resize(sizeof(cpu_set_t));
+        if(sched_getaffinity(0, sizeof(cpu_set_t), (cpu_set_t*)m_mask.data()) != 0)
+            m_mask.clear();
+#endif
+    }
+
+    AffinityGuard::~AffinityGuard()
+    {
+        current_numa_node = m_node;
+#ifdef __linux__
+        if(!m_mask.empty())
+            sched_setaffinity(0, sizeof(cpu_set_t), (const cpu_set_t*)m_mask.data());
+#endif
+    }
+
+}
@@ -0,0 +1,84 @@
+#ifndef RAYTRACER_RENDERING_THREADING_HPP
+#define RAYTRACER_RENDERING_THREADING_HPP
+
+#include <new>
+#include <vector>
+#include <cstdlib>
+#include "../../core.hpp"
+
+namespace raytracer
+{
+
+    /*
+        Processor layout of the machine, cpus grouped per numa node.
+        Read from /sys/devices/system/node on linux, other platforms (or machines without
+        numa information) report a single node containing every hardware thread.
+    */
+
+    class CpuTopology : public Object
+    {
+    public:
+        CpuTopology();
+
+        size_t node_count() const;
+        const std::vector<int>& cpus(size_t node) const;
+
+        //returns the cpu and node the n-th worker should be placed on,
+        //workers are spread round-robin over the nodes so both sockets fill up evenly.
+        int worker_cpu(size_t worker) const;
+        size_t worker_node(size_t worker) const;
+
+        virtual std::string to_string() const;
+
+    protected:
+        std::vector<std::vector<int>> m_nodes;
+    };
+
+    //pins the calling thread to a single cpu, returns false when not supported or refused.
+    bool pin_current_thread(int cpu);
+
+    //node the calling (render)thread is running on, 0 for unpinned threads.
+    size_t numa_node();
+    void numa_node(size_t node);
+
+    //memory written by one thread only should not share cache lines with memory of other threads.
+    static const size_t cache_line_size = 64;
+
+    //allocator handing out cache line aligned blocks, for per thread buffers.
+    template<class T>
+    struct CacheAlignedAllocator
+    {
+        typedef T value_type;
+
+        CacheAlignedAllocator() = default;
+        template<class U> CacheAlignedAllocator(const CacheAlignedAllocator<U>&) { }
+
+        T* allocate(size_t n)
+        {
+            void *p = nullptr;
+            if(posix_memalign(&p, cache_line_size, n * sizeof(T)) != 0) throw std::bad_alloc();
+            return static_cast<T*>(p);
+        }
+
+        void deallocate(T *p, size_t) { free(p); }
+
+        template<class U> bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+        template<class U> bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+    };
+
+    //saves the affinity of the calling thread and restores it when destroyed.
+    class AffinityGuard
+    {
+    public:
+        AffinityGuard();
+        ~AffinityGuard();
+        AffinityGuard(const AffinityGuard&) = delete;
+
+    protected:
+        std::vector<unsigned char> m_mask;
+        size_t m_node;
+    };
+
+}
+
+#endif
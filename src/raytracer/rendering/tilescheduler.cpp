@@ -0,0 +1,185 @@
+#include "tilescheduler.hpp"
+
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "rendermodel.hpp"
+
+namespace raytracer
+{
+
+    TileScheduler::TileScheduler(const RenderModel &model, bool standalone)
+        : m_model(model), m_standalone(standalone), m_current(0), m_done(0), m_aborted(false) { }
+
+    void TileScheduler::add(RenderJob *job)
+    {
+        job->prepare();
+        std::vector<Tile> tiles = job->tiles();
+        for(size_t i = 0; i < tiles.size(); ++i)
+            if(!job->tile_completed(i)) m_work.push_back(WorkItem{ job, tiles[i], i });
+    }
+
+    //moves tiles overlapping a marked region to the front, then orders by distance to the focus point.
+    void TileScheduler::prioritize()
+    {
+        const std::vector<Tile> &marked = m_model.marked_regions();
+        if(!m_model.focused() && marked.empty()) return;
+
+        auto overlaps = [](const Tile &a, const Tile &b)
+        {
+            return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+        };
+
+        //(unmarked, distance) per work item, marked tiles sort before any unmarked one
+        std::vector<std::pair<bool, double>> keys(m_work.size());
+        std::vector<size_t> order(m_work.size());
+        for(size_t i = 0; i < m_work.size(); ++i)
+        {
+            const WorkItem &item = m_work[i];
+            bool unmarked = true;
+            double distance = 0;
+
+            if(m_model.focused())
+            {
+                double dx = item.tile.x + item.tile.width * 0.5 - m_model.focus_x() * item.job->width();
+                double dy = item.tile.y + item.tile.height * 0.5 - m_model.focus_y() * item.job->height();
+                distance = std::sqrt(dx * dx + dy * dy);
+            }
+
+            for(const Tile &rect : marked)
+                if(overlaps(item.tile, rect)) { unmarked = false; break; }
+
+            keys[i] = std::make_pair(unmarked, distance);
+            order[i] = i;
+        }
+
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+        std::vector<WorkItem> sorted;
+        sorted.reserve(m_work.size());
+        for(size_t i : order) sorted.push_back(m_work[i]);
+        m_work.swap(sorted);
+    }
+
+    void worker(TileScheduler *scheduler, size_t index)
+    {
+        const RenderModel &model = scheduler->m_model;
+        if(model.thread_pinning())
+        {
+            pin_current_thread(model.topology().worker_cpu(index));
+            numa_node(model.topology().worker_node(index));
+        }
+
+        TileScheduler::WorkItem item;
+        while(scheduler->get_work(item))
+        {
+            TileEvent event = item.job->render_tile(item.tile);
+            item.job->complete_tile(item.index);
+            if(!scheduler->completed(event)) break;
+        }
+    }
+
+    bool TileScheduler::get_work(WorkItem &item)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if(m_aborted || m_current >= m_work.size()) return false;
+
+        item = m_work[m_current];
+        ++m_current;
+        return true;
+    }
+
+    //reports a finished tile, false when the callback aborted the render.
+    bool TileScheduler::completed(TileEvent &event)
+    {
+        const TileCallback &callback = m_model.tile_callback();
+        if(!callback || !m_standalone) return true;
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            event.tiles_done = ++m_done;
+            event.tiles_total = m_work.size();
+        }
+
+        if(callback(event)) return true;
+
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_aborted = true;
+        return false;
+    }
+
+    bool TileScheduler::aborted() const { return m_aborted; }
+
+    TileCallback console_progress()
+    {
+        std::shared_ptr<std::mutex> lock = std::make_shared<std::mutex>();
+        std::shared_ptr<size_t> reported = std::make_shared<size_t>(0);
+
+        return [lock, reported](const TileEvent &event)
+        {
+            size_t pr = (event.tiles_done * 100) / event.tiles_total;
+
+            std::lock_guard<std::mutex> guard(*lock);
+            if(pr != *reported || event.tiles_done == 1)
+            {
+                std::cout << "\rProgress: " << pr << "%" << std::flush;
+                *reported = pr;
+            }
+            return true;
+        };
+    }
+
+    TileCallback png_stream(data::PngWriter &writer)
+    {
+        return [&writer](const TileEvent &event)
+        {
+            const Tile &region = event.job->region();
+            for(size_t row = 0; row < event.tile.height; ++row)
+                writer.store(event.tile.x - region.x, event.tile.y - region.y + row, event.pixels + row * event.stride, event.tile.width);
+            return true;
+        };
+    }
+
+    void TileScheduler::run(size_t thread_count)
+    {
+        if(thread_count == 0) thread_count = 1;
+
+        auto current_time = std::chrono::high_resolution_clock::now();
+        m_current = 0;
+        m_done = 0;
+        m_aborted = false;
+        prioritize();
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+
+        //we take part in the render ourself, restore our own placement afterwards.
+        AffinityGuard guard;
+
+        //spawn the threads
+        for(size_t i = 0; i < thread_count - 1; ++i)
+        {
+            threads.push_back(std::thread(worker, this, i + 1));
+        }
+
+        //when subthreads are spawned start working ourself
+        worker(this, 0);
+
+        //when were done wait for other threads to complete
+        for(size_t i = 0; i < thread_count - 1; ++i)
+        {
+            threads[i].join();
+        }
+
+        if(!m_standalone) return;
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - current_time).count();
+        std::cout << "\rrender completed in " << (elapsed / 1000) << " seconds on " << thread_count << " threads." << std::endl;
+    }
+
+    std::string TileScheduler::to_string() const
+    {
+        return "raytracer::TileScheduler - " + std::to_string(m_work.size()) + " tiles";
+    }
+
+}
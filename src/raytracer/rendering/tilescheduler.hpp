@@ -0,0 +1,67 @@
+#ifndef RAYTRACER_RENDERING_TILESCHEDULER_HPP
+#define RAYTRACER_RENDERING_TILESCHEDULER_HPP
+
+#include <mutex>
+#include <vector>
+
+#include "renderjob.hpp"
+#include "../../data/pngwriter.hpp"
+#include "../../core.hpp"
+
+namespace raytracer
+{
+
+    /*
+        Pool of tiles handed out to the render threads. Tiles of several jobs can be queued
+        together, so multiple views of a scene share one set of threads in a single pass.
+        Jobs are prepared (see RenderJob::prepare) when they are added. Tiles are handed out in the
+        order they were added, unless the model has a focus point or marked regions (see prioritize).
+        Schedulers that are not standalone render a part of a larger render (the assignments of a
+        distributed worker): they skip the tile callback and the timing output.
+    */
+
+    class TileScheduler : public Object
+    {
+    public:
+        TileScheduler(const RenderModel &model, bool standalone = true);
+        TileScheduler(const TileScheduler&) = delete;
+
+        void add(RenderJob *job); //prepares the job and queues all its tiles that are not completed yet
+        void run(size_t thread_count);
+        bool aborted() const; //whether the tile callback stopped the last run
+
+        virtual std::string to_string() const;
+
+    protected:
+        friend void worker(TileScheduler *scheduler, size_t index);
+
+        struct WorkItem
+        {
+            RenderJob *job;
+            Tile tile;
+            size_t index; //of the tile within its job
+        };
+
+        const RenderModel &m_model;
+        bool m_standalone;
+        std::vector<WorkItem> m_work;
+
+        size_t m_current;
+        size_t m_done;
+        bool m_aborted;
+        std::mutex m_lock;
+        void prioritize();
+        bool get_work(WorkItem &item);
+        bool completed(TileEvent &event);
+    };
+
+    void worker(TileScheduler *scheduler, size_t index);
+
+    //tile callback printing the render progress to the console.
+    TileCallback console_progress();
+    //tile callback encoding the finished tiles into writer (sized like the rendered region).
+    TileCallback png_stream(data::PngWriter &writer);
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "scene.hpp"
 
 #include <limits>
+#include <mutex>
+#include <thread>
 #include "hit.hpp"
 
 namespace raytracer
@@ -8,13 +10,22 @@ namespace raytracer
 
     Scene::~Scene()
     {
-        for(Shape *sh : m_shapes)
+        clear();
+    }
+
+    void Scene::clear()
+    {
+        for(Shape *sh : m_added_shapes)
             delete sh;
-        m_shapes.clear();
+        m_added_shapes.clear();
 
-        for(PointLight *pl : m_lights)
+        for(PointLight *pl : m_added_lights)
             delete pl;
+        m_added_lights.clear();
+
+        m_shapes.clear();
         m_lights.clear();
+        m_arena.clear();
     }
 
     Hit Scene::closest_hit(const Ray &ray) const
@@ -34,8 +45,32 @@ namespace raytracer
         return min_hit;
     }
 
-    void Scene::add_shape(Shape *shape) { m_shapes.push_back(shape); }
-    void Scene::add_light(PointLight *light) { m_lights.push_back(light); }
+    void Scene::replicate(const CpuTopology &topology)
+    {
+        //models sharing the scene may replicate it at the same time, renders never do.
+        static std::mutex replicate_lock;
+        std::lock_guard<std::mutex> guard(replicate_lock);
+
+        for(Shape *sh : m_shapes)
+            sh->allocate_replicas(topology.node_count());
+
+        std::vector<std::thread> threads;
+        for(size_t node = 0; node < topology.node_count(); ++node)
+        {
+            threads.push_back(std::thread([this, &topology, node]()
+            {
+                pin_current_thread(topology.cpus(node)[0]);
+                for(Shape *sh : m_shapes)
+                    sh->replicate(node);
+            }));
+        }
+
+        for(std::thread &th : threads)
+            th.join();
+    }
+
+    void Scene::add_shape(Shape *shape) { m_shapes.push_back(shape); m_added_shapes.push_back(shape); }
+    void Scene::add_light(PointLight *light) { m_lights.push_back(light); m_added_lights.push_back(light); }
     const std::vector<Shape*>& Scene::shapes() const { return m_shapes; }
     const std::vector<PointLight*>& Scene::lights() const { return m_lights; }
 
@@ -44,6 +79,7 @@ namespace raytracer
         std::string s = "raytracer::Scene\n";
         s += "    Objects: " + std::to_string(m_shapes.size()) + "\n";
         s += "    Lights: " + std::to_string(m_lights.size()) + "\n";
+        s += "    Arena: " + std::to_string(m_arena.size()) + " bytes\n";
         return s;
     }
 
@@ -6,19 +6,43 @@
 #include "pointlight.hpp"
 #include "../core.hpp"
 #include "shapes/shape.hpp"
+#include "arena.hpp"
+#include "rendering/threading.hpp"
 
 namespace raytracer
 {
 
+    /*
+        Owns its shapes, lights and materials. Objects made with create are placed in the scene's
+        arena (contiguous, shapes and lights are added to the scene) and destroyed together with
+        the scene or by clear. Shapes and lights allocated with new can still be added, the scene
+        deletes those, materials are never owned by shapes.
+    */
+
     class Scene : public Object
     {
     public:
-        virtual ~Scene(); //TODO: DEFINE
+        Scene() { }
+        Scene(const Scene&) = delete;
+        virtual ~Scene();
 
         Hit closest_hit(const Ray &ray) const;
 
-        void add_shape(Shape *shape);
-        void add_light(PointLight *light);
+        //creates a Shape (subclass), PointLight or Material in the scene.
+        template<typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            T *object = m_arena.create<T>(std::forward<Args>(args)...);
+            attach(object);
+            return object;
+        }
+
+        void add_shape(Shape *shape); //takes ownership
+        void add_light(PointLight *light); //takes ownership
+        void clear(); //destroys every object, the scene can be filled again (for the next frame)
+
+        //copies read-only shape data to every numa node in the topology, not while the scene is rendered.
+        void replicate(const CpuTopology &topology);
 
         const std::vector<Shape*>& shapes() const;
         const std::vector<PointLight*>& lights() const;
@@ -28,6 +52,13 @@ namespace raytracer
     protected:
         std::vector<Shape*> m_shapes;
         std::vector<PointLight*> m_lights;
+        std::vector<Shape*> m_added_shapes; //allocated with new
+        std::vector<PointLight*> m_added_lights;
+        Arena m_arena;
+
+        void attach(Shape *shape) { m_shapes.push_back(shape); }
+        void attach(PointLight *light) { m_lights.push_back(light); }
+        void attach(Material *material) { }
     };
 
 }
@@ -1,11 +1,14 @@
 #include "mesh.hpp"
 
+#include <map>
 #include <limits>
+#include "../rendering/threading.hpp"
 
 namespace raytracer
 {
 
-    Mesh::Mesh(const std::string &str, Material *mat, const Vector3d &pos, double scale)
+    Mesh::Mesh(const std::string &str, Material *mat, const Vector3d &pos, double scale, TextureCache &cache)
+        : m_default_material(nullptr)
     {
         m_material = mat;
 
@@ -19,17 +22,33 @@ namespace raytracer
         std::cout << "    numtriangles: " << model->numtriangles << std::endl;
         m_triangles.reserve(model->numtriangles);
 
-        read_simple_model(model, pos);
+        std::vector<Material*> by_triangle(model->numtriangles, m_material);
+        if(!m_material && model->mtllibname)
+        {
+            size_t slash = str.find_last_of('/');
+            std::string directory = slash == std::string::npos ? "" : str.substr(0, slash + 1);
+            read_materials(model, directory + model->mtllibname, cache, by_triangle);
+        }
+        for(Material *&tri_mat : by_triangle)
+            if(!tri_mat) tri_mat = default_material();
+
+        read_simple_model(model, pos, by_triangle);
         glmDelete(model);
     }
 
+    Mesh::~Mesh()
+    {
+        for(Material *mat : m_materials) delete mat;
+    }
+
     Hit Mesh::intersect(const Ray &ray)
     {
         Hit min_hit(nullptr, std::numeric_limits<double>::infinity());
+        std::vector<Triangle> &triangles = m_replicas.empty() ? m_triangles : m_replicas[numa_node()];
 
-        for(size_t i = 0; i < m_triangles.size(); ++i)
+        for(size_t i = 0; i < triangles.size(); ++i)
         {
-            Hit hit = m_triangles[i].intersect(ray);
+            Hit hit = triangles[i].intersect(ray);
             if(hit.distance() < min_hit.distance())
             {
                 min_hit = hit;
@@ -40,8 +59,52 @@ namespace raytracer
         return min_hit;
     }
 
+    void Mesh::allocate_replicas(size_t count)
+    {
+        if(m_replicas.size() == count) return;
 
-    void Mesh::read_simple_model(GLMmodel *model, const Vector3d &pos)
+        m_replicas.clear();
+        m_replicas.resize(count);
+    }
+
+    void Mesh::replicate(size_t node)
+    {
+        //first touch: the pages end up on the node of the calling thread.
+        if(m_replicas[node].empty())
+            m_replicas[node] = std::vector<Triangle>(m_triangles.begin(), m_triangles.end());
+    }
+
+    void Mesh::read_materials(GLMmodel *model, const std::string &file, TextureCache &cache, std::vector<Material*> &by_triangle)
+    {
+        //textures are shared through the cache, so materials using the same map load it once.
+        std::vector<ObjMaterial> materials = parse_mtl_file(file);
+        std::map<std::string, Material*> by_name;
+        for(const ObjMaterial &mat : materials)
+        {
+            m_materials.push_back(new Material(mat, cache));
+            by_name[mat.m_name] = m_materials.back();
+        }
+
+        //groups without (known) material keep nullptr, the constructor gives them the default material
+        for(GLMgroup *group = model->groups; group; group = group->next)
+        {
+            auto found = by_name.find(model->materials[group->material].name);
+            Material *mat = found != by_name.end() ? found->second : nullptr;
+            for(size_t i = 0; i < group->numtriangles; ++i) by_triangle[group->triangles[i]] = mat;
+        }
+    }
+
+    Material* Mesh::default_material()
+    {
+        if(!m_default_material)
+        {
+            m_default_material = new Material(Vector3d(0.2), Vector3d(0.8), Vector3d(0.0), 65);
+            m_materials.push_back(m_default_material);
+        }
+        return m_default_material;
+    }
+
+    void Mesh::read_simple_model(GLMmodel *model, const Vector3d &pos, const std::vector<Material*> &by_triangle)
     {
         for(size_t i = 0; i < model->numtriangles; ++i)
         {
@@ -61,7 +124,19 @@ namespace raytracer
                 model->vertices[3 * model->triangles[i].vindices[2]+2] + pos.z());
 
             Triangle tri(v0, v1, v2);
-            tri.material(m_material);
+            tri.material(by_triangle[i]);
+
+            //obj indices are 1 based, 0 (or out of range) when the face has no texture coordinates
+            const GLuint *t = model->triangles[i].tindices;
+            if(model->texcoords && t[0] > 0 && t[1] > 0 && t[2] > 0 &&
+               t[0] <= model->numtexcoords && t[1] <= model->numtexcoords && t[2] <= model->numtexcoords)
+            {
+                tri.uv(
+                    Vector3d(model->texcoords[2 * t[0]], model->texcoords[2 * t[0] + 1], 0.0),
+                    Vector3d(model->texcoords[2 * t[1]], model->texcoords[2 * t[1] + 1], 0.0),
+                    Vector3d(model->texcoords[2 * t[2]], model->texcoords[2 * t[2] + 1], 0.0));
+            }
+
             m_triangles.push_back(tri);
         }
     }
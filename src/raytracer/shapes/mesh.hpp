@@ -11,16 +11,26 @@ namespace raytracer
     class Mesh : public Shape
     {
     public:
-        Mesh(const std::string &str, Material *mat, const Vector3d &pos, double scale);
+        //mat is used for every triangle, pass nullptr to use the materials (and texture maps) of the obj's mtl library.
+        Mesh(const std::string &str, Material *mat, const Vector3d &pos, double scale, TextureCache &cache = TextureCache::shared());
+        virtual ~Mesh();
 
         virtual Hit intersect(const Ray &ray);
 
+        virtual void allocate_replicas(size_t count);
+        virtual void replicate(size_t node);
+
         //todo tostring override
     
     protected:
         std::vector<Triangle> m_triangles;
+        std::vector<std::vector<Triangle>> m_replicas; //per numa node copies of m_triangles
+        std::vector<Material*> m_materials; //owned, read from the mtl library
+        Material *m_default_material; //in m_materials once used
 
-        void read_simple_model(GLMmodel *model, const Vector3d &pos);
+        Material* default_material(); //glm's default gray, for triangles without (known) material
+        void read_materials(GLMmodel *model, const std::string &file, TextureCache &cache, std::vector<Material*> &by_triangle);
+        void read_simple_model(GLMmodel *model, const Vector3d &pos, const std::vector<Material*> &by_triangle);
     };
 
 }
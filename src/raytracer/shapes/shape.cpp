@@ -1,5 +1,7 @@
 #include "shape.hpp"
 
+#include <cmath>
+
 #include "../shapes/shape.hpp"
 
 namespace raytracer
@@ -8,9 +10,40 @@ namespace raytracer
     Vector3d Shape::color_at(const Vector3d &point) const
     {
         //std::cout << "shape returning diffuse: " << m_material->m_diffuse.to_string() << std::endl;
-        return m_material->m_diffuse;
+        if(!m_material->m_diffuse_map) return m_material->m_diffuse;
+
+        Vector3d uv = uv_at(point);
+        return m_material->m_diffuse * m_material->m_diffuse_map->sample(uv.x(), uv.y());
+    }
+
+    Vector3d Shape::color_at(const Vector3d &point, const Vector3d &dx, const Vector3d &dy) const
+    {
+        if(!m_material->m_diffuse_map) return m_material->m_diffuse;
+
+        //footprint in texture space, wrapped so seams of the mapping do not look like a huge footprint.
+        Vector3d uv = uv_at(point);
+        Vector3d uv_dx = uv_at(point + dx) - uv;
+        Vector3d uv_dy = uv_at(point + dy) - uv;
+        uv_dx = Vector3d(uv_dx.x() - std::round(uv_dx.x()), uv_dx.y() - std::round(uv_dx.y()), 0.0);
+        uv_dy = Vector3d(uv_dy.x() - std::round(uv_dy.x()), uv_dy.y() - std::round(uv_dy.y()), 0.0);
+
+        Texture *map = m_material->m_diffuse_map;
+        return m_material->m_diffuse * map->sample(uv.x(), uv.y(), map->level(uv_dx, uv_dy));
     }
 
+    Vector3d Shape::uv_at(const Vector3d &point) const
+    {
+        return Vector3d(0.0);
+    }
+
+    Vector3d Shape::normal_differential(const Vector3d &point, const Vector3d &normal, const Vector3d &dp) const
+    {
+        return Vector3d(0.0);
+    }
+
+    void Shape::allocate_replicas(size_t count) { }
+    void Shape::replicate(size_t node) { }
+
     Material* Shape::material() const
     {
         return m_material;
@@ -17,12 +17,21 @@ namespace raytracer
     {
     public:
         Shape() : m_material(nullptr) {}
-        virtual ~Shape() { if(m_material) { delete m_material; /*std::cout << "deleted material\n";*/ } }
+        virtual ~Shape() { } //materials belong to the scene (or whoever made them), not the shape
 
         virtual Material* material() const;
         virtual void material(Material *mat);
         virtual Hit intersect(const Ray &ray) = 0;
-        virtual Vector3d color_at(const Vector3d &point) const;
+        virtual Vector3d color_at(const Vector3d &point) const; //samples the diffuse map if there is one
+        //filtered over the footprint of a pixel, dx and dy being the differentials of point (see Ray).
+        virtual Vector3d color_at(const Vector3d &point, const Vector3d &dx, const Vector3d &dy) const;
+        virtual Vector3d uv_at(const Vector3d &point) const; //texture coordinates (x, y) of a point on the shape
+        //change of the (hit) normal at point when moving dp over the surface, 0 for flat shapes.
+        virtual Vector3d normal_differential(const Vector3d &point, const Vector3d &normal, const Vector3d &dp) const;
+
+        //numa replication of bulky read-only data, replicate(node) is called from a thread running on that node.
+        virtual void allocate_replicas(size_t count);
+        virtual void replicate(size_t node);
     
         //base override
         virtual std::string to_string() const;
@@ -1,5 +1,9 @@
 #include "sphere.hpp"
 
+#include <cmath>
+#include <algorithm>
+#include "../../math/math.hpp"
+
 namespace raytracer
 {
 
@@ -35,4 +39,17 @@ namespace raytracer
         return Hit(this, t, N);
     }
 
+    Vector3d Sphere::uv_at(const Vector3d &point) const
+    {
+        Vector3d N = (point - m_center) / m_radius;
+        double y = std::max(-1.0, std::min(1.0, N.y()));
+        return Vector3d(0.5 + std::atan2(N.z(), N.x()) / (2 * math::pi), 0.5 + std::asin(y) / math::pi, 0.0);
+    }
+
+    Vector3d Sphere::normal_differential(const Vector3d &point, const Vector3d &normal, const Vector3d &dp) const
+    {
+        //normals of hits from inside point to the center
+        return normal.dot(point - m_center) < 0 ? -dp / m_radius : dp / m_radius;
+    }
+
 }
\ No newline at end of file
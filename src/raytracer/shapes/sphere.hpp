@@ -15,6 +15,8 @@ namespace raytracer
         virtual ~Sphere() { };
 
         virtual Hit intersect(const Ray &ray);
+        virtual Vector3d uv_at(const Vector3d &point) const; //longitude/latitude, poles on the y axis
+        virtual Vector3d normal_differential(const Vector3d &point, const Vector3d &normal, const Vector3d &dp) const;
 
         //TODO: override tostring
     
@@ -29,4 +29,27 @@ namespace raytracer
         return Hit(this, t, e1e2);
     }
 
+    Vector3d Triangle::uv_at(const Vector3d &point) const
+    {
+        //barycentric coordinates of point
+        Vector3d e1 = m_v1 - m_v0;
+        Vector3d e2 = m_v2 - m_v0;
+        Vector3d p = point - m_v0;
+        double d11 = e1.dot(e1), d12 = e1.dot(e2), d22 = e2.dot(e2);
+        double dp1 = p.dot(e1), dp2 = p.dot(e2);
+        double denominator = d11 * d22 - d12 * d12;
+        if(denominator == 0) return m_t0;
+
+        double b1 = (d22 * dp1 - d12 * dp2) / denominator;
+        double b2 = (d11 * dp2 - d12 * dp1) / denominator;
+        return m_t0 * (1.0 - b1 - b2) + m_t1 * b1 + m_t2 * b2;
+    }
+
+    void Triangle::uv(const Vector3d &t0, const Vector3d &t1, const Vector3d &t2)
+    {
+        m_t0 = t0;
+        m_t1 = t1;
+        m_t2 = t2;
+    }
+
 }
\ No newline at end of file
@@ -11,20 +11,24 @@ namespace raytracer
     {
     public:
         Triangle(const Vector3d &v1, const Vector3d &v2, const Vector3d &v3)
-            : m_v0(v1), m_v1(v2), m_v2(v3) { };
-
-        virtual ~Triangle() { m_material = nullptr; } //release material before its deleted by shape
+            : m_v0(v1), m_v1(v2), m_v2(v3), m_t0(0.0, 0.0, 0.0), m_t1(1.0, 0.0, 0.0), m_t2(0.0, 1.0, 0.0) { };
 
         virtual Hit intersect(const Ray &ray);    
+        virtual Vector3d uv_at(const Vector3d &point) const; //interpolated from the vertex texture coordinates
+
+        //texture coordinates of the vertices, barycentric coordinates when not set.
+        void uv(const Vector3d &t0, const Vector3d &t1, const Vector3d &t2);
 
         //TODO: override tostring
         //TODO: add smooth normals
-        //TODO: add texture mapping
 
     protected:
         const Vector3d m_v0;
         const Vector3d m_v1;
         const Vector3d m_v2;
+        Vector3d m_t0;
+        Vector3d m_t1;
+        Vector3d m_t2;
     };
 
 }
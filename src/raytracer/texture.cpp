@@ -0,0 +1,501 @@
+#include "texture.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <climits>
+#include <fstream>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace raytracer
+{
+
+    /*
+        Tiled texture file:
+            TiledTextureHeader
+            per level (largest first), per tile row, per tile: the rgb floats of the tile, row by row
+    */
+
+    static const uint32_t texture_magic = 0x657A7478; //"eztx"
+    static const uint32_t texture_version = 1;
+
+    struct TiledTextureHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width, height;
+        uint32_t levels;
+        uint32_t tile_size;
+    };
+
+    const size_t Texture::tile_size;
+
+    static std::atomic<uint64_t> next_texture_id(1);
+
+    //per thread lookup cache in front of the (locked) cache of tiled textures
+    static const size_t lookup_size = 16;
+    struct TileLookup
+    {
+        uint64_t key = 0;
+        std::shared_ptr<const TextureTile> tile;
+    };
+
+    static inline uint64_t tile_key(uint64_t id, size_t index)
+    {
+        return (id << 32) | index;
+    }
+
+    static inline size_t level_size(size_t size, size_t level)
+    {
+        return std::max<size_t>(1, size >> level);
+    }
+
+    Texture::Texture(const data::Image &image)
+        : m_id(next_texture_id++), m_fd(-1), m_cache(nullptr)
+    {
+        std::vector<std::vector<float>> pyramid = build_pyramid(image);
+        layout(image.width(), image.height());
+
+        for(size_t l = 0; l < m_levels.size(); ++l)
+        {
+            const Level &level = m_levels[l];
+            for(size_t ty = 0; ty < level.tiles_y; ++ty)
+                for(size_t tx = 0; tx < level.tiles_x; ++tx)
+                    m_resident.push_back(cut_tile(pyramid[l], level.width, level.height, tx * tile_size, ty * tile_size));
+        }
+    }
+
+    Texture::Texture(const std::string &file, TextureCache &cache)
+        : m_id(next_texture_id++), m_fd(-1), m_cache(&cache)
+    {
+        m_fd = open(file.c_str(), O_RDONLY);
+        if(m_fd < 0) throw Exception(__PRETTY_FUNCTION__, "failed to open tiled texture " + file);
+
+        TiledTextureHeader header;
+        if(pread(m_fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != texture_magic
+            || header.version != texture_version || header.tile_size != tile_size || header.width == 0 || header.height == 0)
+        {
+            close(m_fd);
+            throw Exception(__PRETTY_FUNCTION__, file + " is not a tiled texture");
+        }
+
+        layout(header.width, header.height);
+        if(header.levels != m_levels.size())
+        {
+            close(m_fd);
+            throw Exception(__PRETTY_FUNCTION__, file + " has an unexpected number of levels");
+        }
+
+        //tiles are stored back to back in index order
+        uint64_t offset = sizeof(header);
+        for(const Level &level : m_levels)
+        {
+            for(size_t ty = 0; ty < level.tiles_y; ++ty)
+            {
+                for(size_t tx = 0; tx < level.tiles_x; ++tx)
+                {
+                    m_offsets.push_back(offset);
+                    size_t w = std::min(tile_size, level.width - tx * tile_size);
+                    size_t h = std::min(tile_size, level.height - ty * tile_size);
+                    offset += w * h * 3 * sizeof(float);
+                }
+            }
+        }
+    }
+
+    Texture::~Texture()
+    {
+        if(m_fd >= 0) close(m_fd);
+    }
+
+    size_t Texture::width(size_t level) const { return m_levels[level].width; }
+    size_t Texture::height(size_t level) const { return m_levels[level].height; }
+    size_t Texture::levels() const { return m_levels.size(); }
+    bool Texture::tiled() const { return m_fd >= 0; }
+
+    size_t Texture::memory_size() const
+    {
+        size_t size = 0;
+        for(const auto &tile : m_resident) size += tile->texels.size() * sizeof(float);
+        return size;
+    }
+
+    void Texture::layout(size_t width, size_t height)
+    {
+        size_t count = 1;
+        while(level_size(width, count - 1) > 1 || level_size(height, count - 1) > 1) ++count;
+
+        size_t first_tile = 0;
+        for(size_t l = 0; l < count; ++l)
+        {
+            Level level;
+            level.width = level_size(width, l);
+            level.height = level_size(height, l);
+            level.tiles_x = (level.width + tile_size - 1) / tile_size;
+            level.tiles_y = (level.height + tile_size - 1) / tile_size;
+            level.first_tile = first_tile;
+            first_tile += level.tiles_x * level.tiles_y;
+            m_levels.push_back(level);
+        }
+    }
+
+    std::vector<std::vector<float>> Texture::build_pyramid(const data::Image &image)
+    {
+        if(image.width() == 0 || image.height() == 0)
+            throw Exception(__PRETTY_FUNCTION__, "can not texture an empty image");
+
+        size_t width = image.width();
+        size_t height = image.height();
+        std::vector<std::vector<float>> pyramid(1, std::vector<float>(width * height * 3));
+
+        std::vector<Vector3d> row(width);
+        for(size_t y = 0; y < height; ++y)
+        {
+            image.load(0, y, row.data(), width);
+            float *out = &pyramid[0][y * width * 3];
+            for(size_t x = 0; x < width; ++x)
+            {
+                out[3 * x + 0] = row[x].x();
+                out[3 * x + 1] = row[x].y();
+                out[3 * x + 2] = row[x].z();
+            }
+        }
+
+        while(width > 1 || height > 1)
+        {
+            const std::vector<float> &src = pyramid.back();
+            size_t dst_width = std::max<size_t>(1, width / 2);
+            size_t dst_height = std::max<size_t>(1, height / 2);
+            std::vector<float> dst(dst_width * dst_height * 3);
+
+            //2x2 box, clamped at the edge of levels with an odd or single pixel dimension.
+            for(size_t y = 0; y < dst_height; ++y)
+            {
+                size_t y0 = std::min(2 * y, height - 1);
+                size_t y1 = std::min(2 * y + 1, height - 1);
+                for(size_t x = 0; x < dst_width; ++x)
+                {
+                    size_t x0 = std::min(2 * x, width - 1);
+                    size_t x1 = std::min(2 * x + 1, width - 1);
+                    for(size_t c = 0; c < 3; ++c)
+                    {
+                        dst[3 * (y * dst_width + x) + c] = 0.25f * (
+                            src[3 * (y0 * width + x0) + c] + src[3 * (y0 * width + x1) + c] +
+                            src[3 * (y1 * width + x0) + c] + src[3 * (y1 * width + x1) + c]);
+                    }
+                }
+            }
+
+            pyramid.push_back(std::move(dst));
+            width = dst_width;
+            height = dst_height;
+        }
+
+        return pyramid;
+    }
+
+    std::shared_ptr<TextureTile> Texture::cut_tile(const std::vector<float> &level, size_t width, size_t height,
+        size_t x, size_t y)
+    {
+        std::shared_ptr<TextureTile> tile = std::make_shared<TextureTile>();
+        tile->width = std::min(tile_size, width - x);
+        tile->height = std::min(tile_size, height - y);
+        tile->texels.resize(tile->width * tile->height * 3);
+
+        for(size_t row = 0; row < tile->height; ++row)
+        {
+            const float *in = &level[3 * ((y + row) * width + x)];
+            std::copy(in, in + 3 * tile->width, &tile->texels[3 * row * tile->width]);
+        }
+        return tile;
+    }
+
+    void Texture::bake(const data::Image &image, const std::string &file)
+    {
+        std::vector<std::vector<float>> pyramid = build_pyramid(image);
+        TiledTextureHeader header = { texture_magic, texture_version, uint32_t(image.width()), uint32_t(image.height()),
+            uint32_t(pyramid.size()), uint32_t(tile_size) };
+
+        std::ofstream out(file, std::ios::binary | std::ios::trunc);
+        if(!out) throw Exception(__PRETTY_FUNCTION__, "failed to create tiled texture " + file);
+        out.write((const char*)&header, sizeof(header));
+
+        for(size_t l = 0; l < pyramid.size(); ++l)
+        {
+            size_t width = level_size(image.width(), l);
+            size_t height = level_size(image.height(), l);
+            for(size_t y = 0; y < height; y += tile_size)
+            {
+                for(size_t x = 0; x < width; x += tile_size)
+                {
+                    std::shared_ptr<TextureTile> tile = cut_tile(pyramid[l], width, height, x, y);
+                    out.write((const char*)tile->texels.data(), tile->texels.size() * sizeof(float));
+                }
+            }
+        }
+
+        out.close();
+        if(!out) throw Exception(__PRETTY_FUNCTION__, "failed to write tiled texture " + file);
+    }
+
+    std::shared_ptr<const TextureTile> Texture::read_tile(size_t index) const
+    {
+        size_t l = 0;
+        while(l + 1 < m_levels.size() && m_levels[l + 1].first_tile <= index) ++l;
+        const Level &level = m_levels[l];
+        size_t tx = (index - level.first_tile) % level.tiles_x;
+        size_t ty = (index - level.first_tile) / level.tiles_x;
+
+        std::shared_ptr<TextureTile> tile = std::make_shared<TextureTile>();
+        tile->width = std::min(tile_size, level.width - tx * tile_size);
+        tile->height = std::min(tile_size, level.height - ty * tile_size);
+        tile->texels.resize(tile->width * tile->height * 3);
+
+        size_t bytes = tile->texels.size() * sizeof(float);
+        if(pread(m_fd, tile->texels.data(), bytes, m_offsets[index]) != ssize_t(bytes))
+            throw Exception(__PRETTY_FUNCTION__, "failed to read texture tile " + std::to_string(index));
+        return tile;
+    }
+
+    const TextureTile& Texture::tile(size_t index) const
+    {
+        if(!m_cache) return *m_resident[index];
+
+        //the tile stays alive in the lookup slot until the slot is reused.
+        thread_local TileLookup lookups[lookup_size];
+        uint64_t key = tile_key(m_id, index);
+        TileLookup &lookup = lookups[(index + m_id * 7) % lookup_size];
+        if(lookup.key != key)
+        {
+            lookup.tile = m_cache->tile(*this, index);
+            lookup.key = key;
+        }
+        return *lookup.tile;
+    }
+
+    void Texture::texel(size_t level, size_t x, size_t y, float *rgb) const
+    {
+        const Level &l = m_levels[level];
+        const TextureTile &t = tile(l.first_tile + (y / tile_size) * l.tiles_x + x / tile_size);
+        const float *in = &t.texels[3 * ((y % tile_size) * t.width + x % tile_size)];
+        rgb[0] = in[0];
+        rgb[1] = in[1];
+        rgb[2] = in[2];
+    }
+
+    Vector3d Texture::bilinear(size_t level, double u, double v) const
+    {
+        const Level &l = m_levels[level];
+
+        //texel centers at half coordinates, wrapped
+        double x = (u - std::floor(u)) * l.width - 0.5;
+        double y = (v - std::floor(v)) * l.height - 0.5;
+        double fx = std::floor(x);
+        double fy = std::floor(y);
+        double tx = x - fx;
+        double ty = y - fy;
+
+        size_t x0 = (static_cast<long>(fx) + l.width) % l.width;
+        size_t y0 = (static_cast<long>(fy) + l.height) % l.height;
+        size_t x1 = (x0 + 1) % l.width;
+        size_t y1 = (y0 + 1) % l.height;
+
+        //copied out one by one, the four texels may come from different tiles
+        float t00[3], t10[3], t01[3], t11[3];
+        texel(level, x0, y0, t00);
+        texel(level, x1, y0, t10);
+        texel(level, x0, y1, t01);
+        texel(level, x1, y1, t11);
+
+        double c[3];
+        for(size_t i = 0; i < 3; ++i)
+        {
+            double top = t00[i] + tx * (t10[i] - t00[i]);
+            double bottom = t01[i] + tx * (t11[i] - t01[i]);
+            c[i] = top + ty * (bottom - top);
+        }
+        return Vector3d(c[0], c[1], c[2]);
+    }
+
+    Vector3d Texture::sample(double u, double v, double level) const
+    {
+        //images are stored top row first, v goes up
+        v = 1.0 - v;
+
+        if(!(level > 0)) return bilinear(0, u, v);
+        size_t last = m_levels.size() - 1;
+        if(level >= last) return bilinear(last, u, v);
+
+        size_t l = static_cast<size_t>(level);
+        double t = level - l;
+        Vector3d a = bilinear(l, u, v);
+        if(t == 0) return a;
+        return a + (bilinear(l + 1, u, v) - a) * t;
+    }
+
+    double Texture::level(const Vector3d &uv_dx, const Vector3d &uv_dy) const
+    {
+        //longest axis of the footprint in texels of level 0, each level halves it.
+        double w = width(), h = height();
+        double x = std::sqrt(uv_dx.x() * uv_dx.x() * w * w + uv_dx.y() * uv_dx.y() * h * h);
+        double y = std::sqrt(uv_dy.x() * uv_dy.x() * w * w + uv_dy.y() * uv_dy.y() * h * h);
+        double footprint = std::max(x, y);
+        return footprint > 1.0 ? std::log2(footprint) : 0.0;
+    }
+
+    std::string Texture::to_string() const
+    {
+        return "raytracer::Texture " + std::to_string(width()) + "x" + std::to_string(height()) +
+            " (" + std::to_string(levels()) + " levels" + (tiled() ? ", tiled" : "") + ")\n";
+    }
+
+    TextureCache::TextureCache(size_t budget, const std::string &directory)
+        : m_budget(budget), m_directory(directory), m_tile_memory(0), m_tile_loads(0) { }
+
+    void TextureCache::budget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_tile_lock);
+        m_budget = bytes;
+        evict();
+    }
+
+    size_t TextureCache::budget() const
+    {
+        std::lock_guard<std::mutex> lock(m_tile_lock);
+        return m_budget;
+    }
+
+    void TextureCache::directory(const std::string &directory)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_directory = directory;
+    }
+
+    const std::string& TextureCache::directory() const
+    {
+        return m_directory;
+    }
+
+    Texture* TextureCache::load(const std::string &file)
+    {
+        char resolved[PATH_MAX];
+        if(!realpath(file.c_str(), resolved))
+            throw Exception(__PRETTY_FUNCTION__, "texture not found: " + file);
+
+        //decoding happens under the lock, so two materials asking for the same file decode it once.
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::unique_ptr<Texture> &texture = m_textures[resolved];
+        if(!texture)
+        {
+            try
+            {
+                std::string path = resolved;
+                bool tiled = path.size() > 4 && path.compare(path.size() - 4, 4, ".ezt") == 0;
+                if(tiled) texture.reset(new Texture(path, *this));
+                else if(budget() == 0) texture.reset(new Texture(data::Image(path)));
+                else
+                {
+                    //bake to a file only this cache knows about, it is removed once opened.
+                    static std::atomic<size_t> counter(0);
+                    std::string baked = m_directory + "/eztrace-" + std::to_string(getpid()) + "-" + std::to_string(counter++) + ".ezt";
+                    Texture::bake(data::Image(path), baked);
+                    try { texture.reset(new Texture(baked, *this)); }
+                    catch(...) { unlink(baked.c_str()); throw; }
+                    unlink(baked.c_str());
+                }
+            }
+            catch(...)
+            {
+                m_textures.erase(resolved);
+                throw;
+            }
+        }
+        return texture.get();
+    }
+
+    std::shared_ptr<const TextureTile> TextureCache::tile(const Texture &texture, size_t index)
+    {
+        uint64_t key = tile_key(texture.m_id, index);
+        {
+            std::lock_guard<std::mutex> lock(m_tile_lock);
+            auto found = m_tiles.find(key);
+            if(found != m_tiles.end())
+            {
+                m_order.splice(m_order.begin(), m_order, found->second.position);
+                return found->second.tile;
+            }
+        }
+
+        //read without holding the lock, a thread loading the same tile meanwhile wins.
+        std::shared_ptr<const TextureTile> tile = texture.read_tile(index);
+        ++m_tile_loads;
+
+        std::lock_guard<std::mutex> lock(m_tile_lock);
+        auto found = m_tiles.find(key);
+        if(found != m_tiles.end()) return found->second.tile;
+
+        m_order.push_front(key);
+        m_tiles[key] = Entry{ tile, m_order.begin() };
+        m_tile_memory += tile->texels.size() * sizeof(float);
+        evict();
+        return tile;
+    }
+
+    void TextureCache::evict()
+    {
+        //the tile just added (at the front) is always kept
+        while(m_budget != 0 && m_tile_memory > m_budget && m_order.size() > 1)
+        {
+            auto found = m_tiles.find(m_order.back());
+            m_tile_memory -= found->second.tile->texels.size() * sizeof(float);
+            m_tiles.erase(found);
+            m_order.pop_back();
+        }
+    }
+
+    size_t TextureCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_textures.size();
+    }
+
+    size_t TextureCache::memory_size() const
+    {
+        size_t size = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for(const auto &texture : m_textures) size += texture.second->memory_size();
+        }
+        std::lock_guard<std::mutex> lock(m_tile_lock);
+        return size + m_tile_memory;
+    }
+
+    size_t TextureCache::tile_loads() const
+    {
+        return m_tile_loads;
+    }
+
+    void TextureCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::lock_guard<std::mutex> tile_lock(m_tile_lock);
+        m_tiles.clear();
+        m_order.clear();
+        m_tile_memory = 0;
+        m_textures.clear();
+    }
+
+    TextureCache& TextureCache::shared()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    std::string TextureCache::to_string() const
+    {
+        return "raytracer::TextureCache " + std::to_string(size()) + " textures, " +
+            std::to_string(memory_size()) + " bytes (budget " + std::to_string(budget()) + ")\n";
+    }
+
+}
@@ -0,0 +1,159 @@
+#ifndef RAYTRACER_TEXTURE_HPP
+#define RAYTRACER_TEXTURE_HPP
+
+#include <map>
+#include <list>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "../core.hpp"
+#include "../data/image.hpp"
+
+namespace raytracer
+{
+
+    class TextureCache; //circular dependency
+
+    //block of up to tile_size x tile_size rgb texels of one mip level, smaller at the right and bottom edges.
+    struct TextureTile
+    {
+        size_t width;
+        size_t height;
+        std::vector<float> texels;
+    };
+
+    /*
+        Image used as a texture, stored as float rgb with a precomputed mip pyramid (every level
+        half the size of the previous, box filtered, down to 1x1). Coordinates wrap around (repeat)
+        and are sampled bilinear within a level, trilinear between levels.
+
+        Levels are split in tiles. Resident textures keep every tile in memory, tiled textures
+        read them on first access from a tiled texture file (see bake) through the cache, which
+        evicts the least recently used tiles to stay within its memory budget.
+    */
+
+    class Texture : public Object
+    {
+    public:
+        Texture(const data::Image &image); //resident
+        Texture(const std::string &file, TextureCache &cache); //tiled, file written by bake
+        Texture(const Texture&) = delete;
+        virtual ~Texture();
+
+        static const size_t tile_size = 64;
+
+        size_t width(size_t level = 0) const;
+        size_t height(size_t level = 0) const;
+        size_t levels() const;
+        bool tiled() const;
+        size_t memory_size() const; //of the resident tiles, in bytes
+
+        //u, v in texture space (0-1 covers the image once), level 0 is the full resolution image.
+        Vector3d sample(double u, double v, double level = 0) const;
+        //level matching a pixel footprint spanning uv_dx and uv_dy (x, y) in texture space.
+        double level(const Vector3d &uv_dx, const Vector3d &uv_dy) const;
+
+        //writes the pyramid of image as tiled texture file.
+        static void bake(const data::Image &image, const std::string &file);
+
+        virtual std::string to_string() const;
+
+    protected:
+        struct Level
+        {
+            size_t width;
+            size_t height;
+            size_t tiles_x;
+            size_t tiles_y;
+            size_t first_tile; //index of the first tile of this level
+        };
+
+        std::vector<Level> m_levels;
+        std::vector<std::shared_ptr<const TextureTile>> m_resident; //every tile, for resident textures
+        std::vector<uint64_t> m_offsets; //in the file, per tile, for tiled textures
+        uint64_t m_id; //unique for the process, part of the tile keys
+        int m_fd;
+        TextureCache *m_cache;
+
+        friend class TextureCache;
+
+        void layout(size_t width, size_t height);
+        const TextureTile& tile(size_t index) const;
+        std::shared_ptr<const TextureTile> read_tile(size_t index) const;
+        void texel(size_t level, size_t x, size_t y, float *rgb) const;
+        Vector3d bilinear(size_t level, double u, double v) const;
+
+        static std::vector<std::vector<float>> build_pyramid(const data::Image &image);
+        static std::shared_ptr<TextureTile> cut_tile(const std::vector<float> &level, size_t width, size_t height,
+            size_t x, size_t y);
+    };
+
+    /*
+        Owns every texture loaded through it, keyed on the canonical path of the file so materials
+        referring to the same image (even through different relative paths) share one texture.
+        Textures live until the cache is cleared or destroyed, materials only keep pointers.
+
+        Without a budget (0, the default) images are resident. With a budget, tiled texture files
+        (.ezt) are opened lazily and other images are baked to an (unlinked) tiled file in the
+        cache directory first, then only the tiles in use are kept, at most budget bytes of them.
+        Render threads look tiles up in a small private cache first, these hold on to a few tiles
+        each, so the actual use can exceed the budget by a few tiles per thread.
+    */
+
+    class TextureCache : public Object
+    {
+    public:
+        TextureCache(size_t budget = 0, const std::string &directory = "/tmp");
+        TextureCache(const TextureCache&) = delete;
+
+        //budget for the tiles of tiled textures in bytes, 0 keeps every image resident.
+        void budget(size_t bytes);
+        size_t budget() const;
+        void directory(const std::string &directory); //for the tiled files of images
+        const std::string& directory() const;
+
+        //loads the texture on first use, thread-safe.
+        Texture* load(const std::string &file);
+
+        size_t size() const;
+        size_t memory_size() const;
+        size_t tile_loads() const; //tiles read from files so far
+        void clear(); //invalidates all textures handed out
+
+        //process wide cache used by materials unless told otherwise.
+        static TextureCache& shared();
+
+        virtual std::string to_string() const;
+
+    protected:
+        struct Entry
+        {
+            std::shared_ptr<const TextureTile> tile;
+            std::list<uint64_t>::iterator position;
+        };
+
+        mutable std::mutex m_lock;
+        std::map<std::string, std::unique_ptr<Texture>> m_textures;
+        size_t m_budget;
+        std::string m_directory;
+
+        //tiles of tiled textures, most recently used at the front of m_order
+        mutable std::mutex m_tile_lock;
+        std::unordered_map<uint64_t, Entry> m_tiles;
+        std::list<uint64_t> m_order;
+        size_t m_tile_memory;
+        std::atomic<size_t> m_tile_loads;
+
+        friend class Texture;
+
+        std::shared_ptr<const TextureTile> tile(const Texture &texture, size_t index);
+        void evict(); //expects m_tile_lock
+    };
+
+}
+
+#endif